@@ -65,6 +65,114 @@ namespace VroomJs.Tests
         {
             js.Execute("a+§");
         }
+
+        [TestCase]
+        public void StringExceptionMessage()
+        {
+            try {
+                js.Execute("throw 'xxx'");
+                Assert.Fail();
+            }
+            catch (JsException e) {
+                Assert.That(e.Message, Is.EqualTo("xxx"));
+                Assert.That(e.Line, Is.EqualTo(1));
+            }
+        }
+
+        [TestCase]
+        public void ErrorObjectDetails()
+        {
+            try {
+                js.Execute("var a = 1;\nthrow new Error('boom');");
+                Assert.Fail();
+            }
+            catch (JsException e) {
+                Assert.That(e.Message, Is.EqualTo("Error: boom"));
+                Assert.That(e.Line, Is.EqualTo(2));
+                Assert.That(e.SourceLine, Is.EqualTo("throw new Error('boom');"));
+                Assert.That(e.NativeException, Is.Not.Null);
+                Assert.That(e.StackFrames, Is.Empty);
+            }
+        }
+
+        [TestCase]
+        public void ThrowingToString()
+        {
+            try {
+                js.Execute("throw { toString: function () { throw 1; } }");
+                Assert.Fail();
+            }
+            catch (JsException e) {
+                Assert.That(e.Message, Is.Not.Null);
+                Assert.That(e.JsStackTrace, Is.Null);
+                Assert.That(e.Line, Is.EqualTo(1));
+            }
+        }
+
+        [TestCase]
+        public void ExceptionAfterDispose()
+        {
+            JsException error = null;
+            using (var engine = new JsEngine()) {
+                try {
+                    engine.Execute("var a = 1;\nthrow 'xxx'");
+                }
+                catch (JsException e) {
+                    error = e;
+                }
+            }
+            Assert.That(error.Message, Is.EqualTo("xxx"));
+            Assert.That(error.Line, Is.EqualTo(2));
+            Assert.That(error.Column, Is.EqualTo(1));
+            Assert.That(error.SourceLine, Is.Null);
+        }
+
+        [TestCase]
+        public void DisposeException()
+        {
+            try {
+                js.Execute("throw 'xxx'");
+                Assert.Fail();
+            }
+            catch (JsException e) {
+                Assert.That(e.Message, Is.EqualTo("xxx"));
+                e.Dispose();
+                Assert.That(e.Message, Is.EqualTo("xxx"));
+                Assert.That(e.Line, Is.EqualTo(0));
+            }
+        }
+
+        [TestCase]
+        public void FinalizedExceptions()
+        {
+            for (int i=0 ; i < 100 ; i++) {
+                try {
+                    js.Execute("throw new Error('boom')");
+                }
+                catch (JsException) {
+                }
+            }
+            GC.Collect();
+            GC.WaitForPendingFinalizers();
+            Assert.That(js.Execute("1 + 1"), Is.EqualTo(2));
+        }
+
+        [TestCase]
+        public void CapturedStackFrames()
+        {
+            js.StackCaptureDepth = 10;
+            try {
+                js.Execute("function f() { throw 'xxx'; }\nfunction g() { f(); }\ng();");
+                Assert.Fail();
+            }
+            catch (JsException e) {
+                JsStackFrame[] frames = e.StackFrames;
+                Assert.That(frames.Length, Is.EqualTo(3));
+                Assert.That(frames[0].FunctionName, Is.EqualTo("f"));
+                Assert.That(frames[1].FunctionName, Is.EqualTo("g"));
+                Assert.That(e.JsStackTrace, Is.StringContaining("at g"));
+            }
+        }
     }
 }
 
@@ -0,0 +1,107 @@
+// This file is part of the VroomJs library.
+//
+// Author:
+//     Federico Di Gregorio <fog@initd.org>
+//
+// Copyright (c) 2013 
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+using System;
+using System.IO;
+using NUnit.Framework;
+
+namespace VroomJs.Tests
+{
+    [TestFixture]
+    public class Files
+    {
+        JsEngine js;
+        string path;
+
+        [SetUp]
+        public void Setup()
+        {
+            js = new JsEngine();
+            path = Path.GetTempFileName();
+        }
+
+        [TearDown]
+        public void Teardown()
+        {
+            js.Dispose();
+            File.Delete(path);
+        }
+
+        [Test]
+        public void ExecuteFile()
+        {
+            File.WriteAllText(path, "var x = 40;\nx + 2");
+            Assert.That(js.ExecuteFile(path), Is.EqualTo(42));
+            Assert.That(js.GetVariable("x"), Is.EqualTo(40));
+        }
+
+        [Test]
+        public void ExecuteFileError()
+        {
+            File.WriteAllText(path, "var x = 1;\nthrow new Error('boom');");
+            try {
+                js.ExecuteFile(path);
+                Assert.Fail();
+            }
+            catch (JsException e) {
+                Assert.That(e.ScriptName, Is.EqualTo(path));
+                Assert.That(e.Line, Is.EqualTo(2));
+            }
+        }
+
+        [Test]
+        [ExpectedException(typeof(JsException))]
+        public void ExecuteMissingFile()
+        {
+            js.ExecuteFile(path + ".missing");
+        }
+
+        [Test]
+        public void LoadModuleOnce()
+        {
+            File.WriteAllText(path, "var loaded = (typeof loaded == 'undefined' ? 0 : loaded) + 1; ({ answer: 42 })");
+            dynamic m1 = js.LoadModule(path);
+            dynamic m2 = js.LoadModule(path);
+            Assert.That(m1.answer, Is.EqualTo(42));
+            Assert.That(m2.answer, Is.EqualTo(42));
+            Assert.That(js.GetVariable("loaded"), Is.EqualTo(1));
+        }
+
+        [Test]
+        public void ReloadReplacedModule()
+        {
+            // Same size and (most likely) the same second: only the inode changes.
+            File.WriteAllText(path, "({ answer: 42 })");
+            dynamic m1 = js.LoadModule(path);
+            string next = path + ".next";
+            File.WriteAllText(next, "({ answer: 43 })");
+            File.Delete(path);
+            File.Move(next, path);
+            dynamic m2 = js.LoadModule(path);
+            Assert.That(m1.answer, Is.EqualTo(42));
+            Assert.That(m2.answer, Is.EqualTo(43));
+        }
+    }
+}
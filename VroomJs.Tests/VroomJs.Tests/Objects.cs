@@ -24,6 +24,7 @@
 // THE SOFTWARE.
 
 using System;
+using System.Linq;
 using NUnit.Framework;
 
 namespace VroomJs.Tests
@@ -175,6 +176,169 @@ namespace VroomJs.Tests
             Assert.That(a[1], Is.EqualTo("Can't believe this worked!"));
         }
 
+        [Test]
+        public void CallJsFunctionInlineArgsBoundary()
+        {
+            js.Execute("var x = { f: function (a, b, c, d, e) { return [a, b, c, d, e]; } }");
+            dynamic x = js.GetVariable("x");
+            object r4 = x.f(1, "b", 3.5, "d");
+            object r5 = x.f(1, "b", 3.5, "d", 5);
+            Assert.That(r4, Is.EqualTo(new object[] { 1, "b", 3.5, "d", null }));
+            Assert.That(r5, Is.EqualTo(new object[] { 1, "b", 3.5, "d", 5 }));
+        }
+
+        [Test]
+        public void CallManagedMethodInlineArgsBoundary()
+        {
+            js.SetVariable("o", new TestClass());
+            Assert.That(js.Execute("o.Concat4('a', 'b', 'c', 'd')"), Is.EqualTo("abcd"));
+            Assert.That(js.Execute("o.Concat5('a', 'b', 'c', 'd', 'e')"), Is.EqualTo("abcde"));
+        }
+
+        [Test]
+        [ExpectedException(typeof(JsInteropException))]
+        public void CallJsFunctionWithBadArg()
+        {
+            js.Execute("var x = { f: function (a, b) { return a; } }");
+            var parent = new ByValueNode { Name = "parent" };
+            parent.Child = new ByValueNode { Parent = parent };
+            dynamic x = js.GetVariable("x");
+            x.f("a", parent);
+        }
+
+        [Test]
+        public void EnumerateJsObjectKeys()
+        {
+            js.Execute("var x = { a: 1, b: 2, c: 3 }");
+            JsObject x = (JsObject)js.GetVariable("x");
+            Assert.That(x.Enumerate(2).ToArray(), Is.EqualTo(new object[] { "a", "b", "c" }));
+        }
+
+        [Test]
+        public void EnumerateJsArrayProperty()
+        {
+            js.Execute("var x = { data: [] }; for (var i=0 ; i < 10000 ; i++) x.data.push(i)");
+            JsObject x = (JsObject)js.GetVariable("x");
+            int n = 0;
+            foreach (object o in x.EnumerateProperty("data", 333)) {
+                Assert.That(o, Is.EqualTo(n));
+                n++;
+            }
+            Assert.That(n, Is.EqualTo(10000));
+        }
+
+        [Test]
+        public void EnumerateVariable()
+        {
+            js.Execute("var a = ['x', 'y']");
+            Assert.That(js.EnumerateVariable("a").ToArray(), Is.EqualTo(new object[] { "x", "y" }));
+        }
+
+        [Test]
+        public void AbandonEnumerator()
+        {
+            js.Execute("var a = [1, 2, 3]");
+            for (int i=0 ; i < 100 ; i++) {
+                var e = js.EnumerateVariable("a", 1).GetEnumerator();
+                Assert.That(e.MoveNext(), Is.True);
+            }
+            GC.Collect();
+            GC.WaitForPendingFinalizers();
+            Assert.That(js.Execute("a.length"), Is.EqualTo(3));
+        }
+
+        [Test]
+        public void EnumeratorOutlivesEngine()
+        {
+            var engine = new JsEngine();
+            engine.Execute("var a = [1, 2, 3]");
+            var e = engine.EnumerateVariable("a", 1).GetEnumerator();
+            Assert.That(e.MoveNext(), Is.True);
+            engine.Dispose();
+            e.Dispose();
+        }
+
+        [Test]
+        public void EnumerateThrowingProperty()
+        {
+            js.Execute("var x = {}; Object.defineProperty(x, 'data', { get: function () { throw new Error('nope'); } })");
+            JsObject x = (JsObject)js.GetVariable("x");
+            try {
+                x.EnumerateProperty("data", 10).ToArray();
+                Assert.Fail();
+            }
+            catch (JsException e) {
+                Assert.That(e.Message, Is.EqualTo("Error: nope"));
+            }
+        }
+
+        [Test]
+        public void GetByValueProperties()
+        {
+            var t = new ByValueTestClass { Int32Property = 42, StringProperty = "answer", ArrayProperty = new[] { 1, 2 } };
+            js.SetVariable("o", t);
+            Assert.That(js.Execute("o.StringProperty + ' ' + o.Int32Property + ' ' + o.ArrayProperty[1]"), Is.EqualTo("answer 42 2"));
+            Assert.That(js.Execute("Object.keys(o).length"), Is.EqualTo(4));
+            Assert.That(js.GetStats().KeepAliveGetPropertyValueCalls, Is.EqualTo(0));
+        }
+
+        [Test]
+        public void GetByValueSingleAllocation()
+        {
+            var t = new ByValueTestClass { StringProperty = "answer", ArrayProperty = new[] { 1, 2 } };
+            long before = js.GetStats().BridgeJsValueAllocations;
+            js.SetVariable("o", t);
+            Assert.That(js.GetStats().BridgeJsValueAllocations - before, Is.EqualTo(1));
+            Assert.That(js.Execute("o.StringProperty + ' ' + o.ArrayProperty.length"), Is.EqualTo("answer 2"));
+        }
+
+        [Test]
+        public void SetByValuePropertyIsACopy()
+        {
+            var t = new ByValueTestClass { Int32Property = 1 };
+            js.SetVariable("o", t);
+            js.Execute("o.Int32Property = 2");
+            Assert.That(t.Int32Property, Is.EqualTo(1));
+            Assert.That(js.Execute("o.Int32Property"), Is.EqualTo(2));
+        }
+
+        [Test]
+        public void GetByValueNestedManagedObject()
+        {
+            var t = new ByValueTestClass { NestedObject = new TestClass { StringProperty = "nested" } };
+            js.SetVariable("o", t);
+            Assert.That(js.Execute("o.NestedObject.StringProperty"), Is.EqualTo("nested"));
+            js.Execute("o.NestedObject.StringProperty = 'changed'");
+            Assert.That(t.NestedObject.StringProperty, Is.EqualTo("changed"));
+        }
+
+        [Test]
+        public void GetByValueSharedObject()
+        {
+            var leaf = new ByValueNode { Name = "leaf" };
+            js.SetVariable("o", new ByValueNode { Parent = leaf, Child = leaf });
+            Assert.That(js.Execute("o.Parent.Name + o.Child.Name"), Is.EqualTo("leafleaf"));
+        }
+
+        [Test]
+        [ExpectedException(typeof(JsInteropException))]
+        public void SetByValueCycle()
+        {
+            var parent = new ByValueNode { Name = "parent" };
+            parent.Child = new ByValueNode { Name = "child", Parent = parent };
+            js.SetVariable("o", parent);
+        }
+
+        [Test]
+        public void ProjectRegisteredTypeByValue()
+        {
+            js.ProjectByValue(typeof(TestClass));
+            js.SetVariable("o", new TestClass { Int32Property = 42 });
+            Assert.That(js.Execute("o.Int32Property"), Is.EqualTo(42));
+            Assert.That(js.Execute("typeof o.Method1"), Is.EqualTo("undefined"));
+            Assert.That(js.GetStats().KeepAliveGetPropertyValueCalls, Is.EqualTo(0));
+        }
+
     }
 }
 
@@ -0,0 +1,129 @@
+// This file is part of the VroomJs library.
+//
+// Author:
+//     Federico Di Gregorio <fog@initd.org>
+//
+// Copyright (c) 2013 
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+using System;
+using System.Linq;
+using NUnit.Framework;
+
+namespace VroomJs.Tests
+{
+    [TestFixture]
+    public class Parallel
+    {
+        JsEngine[] engines;
+
+        [SetUp]
+        public void Setup()
+        {
+            engines = new JsEngine[] { new JsEngine(), new JsEngine(), new JsEngine() };
+        }
+
+        [TearDown]
+        public void Teardown()
+        {
+            foreach (JsEngine js in engines)
+                js.Dispose();
+        }
+
+        [Test]
+        public void MapKeepsOrder()
+        {
+            object[] input = Enumerable.Range(0, 1000).Cast<object>().ToArray();
+            object[] res = JsEngine.ParallelMap(engines, "function (x, i) { return x * 2 + i; }", input, 7);
+
+            Assert.That(res.Length, Is.EqualTo(1000));
+            for (int i=0 ; i < res.Length ; i++)
+                Assert.That(res[i], Is.EqualTo(i * 3));
+            foreach (JsEngine js in engines)
+                Assert.That(js.GetStats().ParallelMapCalls, Is.EqualTo(1));
+        }
+
+        [Test]
+        public void MapArraysAndStrings()
+        {
+            object[] input = new object[] { "a", new object[] { 1, "b" }, null };
+            object[] res = JsEngine.ParallelMap(engines, "function (x) { return [x]; }", input);
+
+            Assert.That(res[0], Is.EqualTo(new object[] { "a" }));
+            Assert.That(res[1], Is.EqualTo(new object[] { new object[] { 1, "b" } }));
+            Assert.That(res[2], Is.EqualTo(new object[] { null }));
+        }
+
+        [Test]
+        public void MapEmptyInput()
+        {
+            Assert.That(JsEngine.ParallelMap(engines, "function (x) { return x; }", new object[0]), Is.Empty);
+        }
+
+        [Test]
+        [ExpectedException(typeof(JsException))]
+        public void MapThrows()
+        {
+            object[] input = new object[] { 1, 2, 3 };
+            JsEngine.ParallelMap(engines, "function (x) { if (x == 2) throw new Error('two'); return x; }", input);
+        }
+
+        [Test]
+        public void MapHugeChunkSize()
+        {
+            object[] res = JsEngine.ParallelMap(engines, "function (x) { return x + 1; }", new object[] { 1, 2, 3 }, int.MaxValue);
+            Assert.That(res, Is.EqualTo(new object[] { 2, 3, 4 }));
+        }
+
+        [Test]
+        public void MapErrorPosition()
+        {
+            try {
+                JsEngine.ParallelMap(engines, "function (x) {\n throw new Error('boom'); }", new object[] { 1 });
+                Assert.Fail();
+            }
+            catch (JsException e) {
+                Assert.That(e.Message, Is.StringContaining("Error: boom"));
+                Assert.That(e.Message, Is.StringContaining("line 2"));
+            }
+        }
+
+        [Test]
+        [ExpectedException(typeof(JsException))]
+        public void MapThrowingToString()
+        {
+            JsEngine.ParallelMap(engines, "function (x) { throw { toString: function () { throw 1; } }; }", new object[] { 1 });
+        }
+
+        [Test]
+        [ExpectedException(typeof(JsException))]
+        public void MapObjectResult()
+        {
+            JsEngine.ParallelMap(engines, "function (x) { return { x: x }; }", new object[] { 1 });
+        }
+
+        [Test]
+        [ExpectedException(typeof(ArgumentException))]
+        public void MapManagedInput()
+        {
+            JsEngine.ParallelMap(engines, "function (x) { return x; }", new object[] { new TestClass() });
+        }
+    }
+}
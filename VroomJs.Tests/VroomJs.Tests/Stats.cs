@@ -0,0 +1,119 @@
+// This file is part of the VroomJs library.
+//
+// Author:
+//     Federico Di Gregorio <fog@initd.org>
+//
+// Copyright (c) 2013 
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+using System;
+using System.Linq;
+using NUnit.Framework;
+
+namespace VroomJs.Tests
+{
+    [TestFixture]
+    public class Stats
+    {
+        JsEngine js;
+
+        [SetUp]
+        public void Setup()
+        {
+            js = new JsEngine();
+        }
+
+        [TearDown]
+        public void Teardown()
+        {
+            js.Dispose();
+        }
+
+        [Test]
+        public void CountEntryPoints()
+        {
+            js.Execute("var x = 1");
+            js.Execute("x + 1");
+            js.GetVariable("x");
+            JsEngineStats s = js.GetStats();
+            Assert.That(s.ExecuteCalls, Is.EqualTo(2));
+            Assert.That(s.GetVariableCalls, Is.EqualTo(1));
+            Assert.That(s.CompileLatency.Sum(), Is.EqualTo(2));
+            Assert.That(s.RunLatency.Sum(), Is.EqualTo(2));
+        }
+
+        [Test]
+        public void CountReverseCallsAndBytes()
+        {
+            var t = new TestClass { StringProperty = "abcd" };
+            js.SetVariable("o", t);
+            js.Execute("o.StringProperty");
+            JsEngineStats s = js.GetStats();
+            Assert.That(s.KeepAliveGetPropertyValueCalls, Is.EqualTo(1));
+            Assert.That(s.BytesFromV8, Is.GreaterThanOrEqualTo(8));
+            Assert.That(s.JsValueAllocations, Is.GreaterThanOrEqualTo(1));
+        }
+
+        [Test]
+        public void CountBridgeAllocations()
+        {
+            long before = js.GetStats().BridgeJsValueAllocations;
+            js.SetVariable("s", "abcd");
+            js.SetVariable("a", new object[] { 1, 2 });
+            Assert.That(js.GetStats().BridgeJsValueAllocations - before, Is.GreaterThanOrEqualTo(2));
+        }
+
+        [Test]
+        public void StatsAfterDispose()
+        {
+            var engine = new JsEngine();
+            engine.Execute("1");
+            engine.Dispose();
+            JsEngineStats s = engine.GetStats();
+            Assert.That(s.ExecuteCalls, Is.EqualTo(0));
+            Assert.That(s.RunLatency.Sum(), Is.EqualTo(0));
+        }
+
+        [Test]
+        [ExpectedException(typeof(InvalidOperationException))]
+        public void SetSamplingIntervalAfterEngineCreation()
+        {
+            JsEngine.SetProfilerSamplingInterval(100);
+        }
+
+        [Test]
+        public void ProfileScript()
+        {
+            js.StartProfiling();
+            js.Execute("function f(n) { var s = 0; for (var i=0 ; i < n ; i++) s += Math.sqrt(i); return s; } f(5000000)");
+            JsProfile p = js.StopProfiling();
+            Assert.That(p.Nodes.Count, Is.GreaterThan(0));
+            Assert.That(p.Nodes[0].Parent, Is.EqualTo(-1));
+            Assert.That(p.Nodes.Skip(1).All(n => n.Parent >= 0));
+        }
+
+        [Test]
+        [ExpectedException(typeof(JsException))]
+        public void StopProfilingWithoutStart()
+        {
+            js.StopProfiling();
+        }
+    }
+}
@@ -35,6 +35,32 @@ namespace VroomJs.Tests
         {
             return new TestClass { Int32Property = this.Int32Property + i, StringProperty = this.StringProperty + s };
         }
+
+        public string Concat4(string a, string b, string c, string d)
+        {
+            return a + b + c + d;
+        }
+
+        public string Concat5(string a, string b, string c, string d, string e)
+        {
+            return a + b + c + d + e;
+        }
+    }
+
+    [JsByValue]
+    public class ByValueTestClass
+    {
+        public int Int32Property { get; set; }
+        public string StringProperty { get; set; }
+        public int[] ArrayProperty { get; set; }
+        public TestClass NestedObject { get; set; }
     }
-}
 
+    [JsByValue]
+    public class ByValueNode
+    {
+        public string Name { get; set; }
+        public ByValueNode Parent { get; set; }
+        public ByValueNode Child { get; set; }
+    }
+}
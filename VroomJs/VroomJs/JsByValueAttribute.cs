@@ -0,0 +1,45 @@
+// This file is part of the VroomJs library.
+//
+// Author:
+//     Federico Di Gregorio <fog@initd.org>
+//
+// Copyright (c) 2013 
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+using System;
+
+namespace VroomJs
+{
+    // Instances of classes or structs marked with this attribute are passed to
+    // Javascript by value: their public properties are copied into a plain JS
+    // object when the object is passed instead of being read on demand from the
+    // CLR (one reverse call for each read); the whole object, including nested
+    // by-value objects and arrays, crosses the bridge in a single call. Changes
+    // made by scripts are not reflected on the CLR object; objects that
+    // reference themselves, directly or not, can't be passed by value
+    // (JsInteropException).
+    // See also JsEngine.ProjectByValue() to do the same for types you can't
+    // decorate.
+
+    [AttributeUsage(AttributeTargets.Class | AttributeTargets.Struct, Inherited = false)]
+    public sealed class JsByValueAttribute : Attribute
+    {
+    }
+}
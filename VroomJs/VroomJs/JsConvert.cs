@@ -24,6 +24,9 @@
 // THE SOFTWARE.
 
 using System;
+using System.Collections.Generic;
+using System.Linq;
+using System.Reflection;
 using System.Runtime.InteropServices;
 
 namespace VroomJs
@@ -37,6 +40,32 @@ namespace VroomJs
 
         readonly JsEngine _engine;
 
+        // Properties copied for each type projected by value, or null for types
+        // passed by reference (see JsByValueAttribute); filled lazily.
+        readonly Dictionary<Type, PropertyInfo[]> _byValue = new Dictionary<Type, PropertyInfo[]>();
+
+        public void ProjectByValue(Type type)
+        {
+            _byValue[type] = GetByValueProperties(type);
+        }
+
+        static PropertyInfo[] GetByValueProperties(Type type)
+        {
+            return type.GetProperties(BindingFlags.Instance|BindingFlags.Public)
+                .Where(pi => pi.CanRead && pi.GetIndexParameters().Length == 0).ToArray();
+        }
+
+        PropertyInfo[] GetProjectedProperties(Type type)
+        {
+            PropertyInfo[] props;
+            if (!_byValue.TryGetValue(type, out props)) {
+                if (type.IsDefined(typeof(JsByValueAttribute), false))
+                    props = GetByValueProperties(type);
+                _byValue.Add(type, props);
+            }
+            return props;
+        }
+
         public object FromJsValue(JsValue v)
         {
             switch (v.Type) 
@@ -94,11 +123,131 @@ namespace VroomJs
                 case JsValueType.WrappedError:
                     return new JsException(new JsObject(_engine, v.Ptr));
 
+                case JsValueType.ErrorInfo:
+                    return new JsException(new JsErrorInfo(_engine, v.Ptr));
+
                 default:
                     throw new InvalidOperationException("unknown type code: " + v.Type);
             }           
         }
 
+        // True for values that convert to a jsvalue without references to a
+        // specific engine (no keepalives): primitive values and arrays of them.
+
+        public static bool IsPortable(object obj)
+        {
+            if (obj == null)
+                return true;
+
+            var array = obj as object[];
+            if (array != null) {
+                foreach (object o in array) {
+                    if (!IsPortable(o))
+                        return false;
+                }
+                return true;
+            }
+
+            Type type = obj.GetType();
+            return type.IsPrimitive && type != typeof(IntPtr) && type != typeof(UIntPtr)
+                || type == typeof(String) || type == typeof(Decimal) || type == typeof(DateTime);
+        }
+
+        // Objects projected by value are written to _nodes and _text, in our own
+        // memory, and copied to the unmanaged side with a single call to
+        // jsvalue_from_nodes: strings, arrays and dicts refer to their characters
+        // and children by offset (in I32) instead of by pointer.
+        JsValue[] _nodes = new JsValue[64];
+        int _nodeCount;
+        char[] _text = new char[256];
+        int _textLength;
+
+        // Objects being projected by value, from the outermost one: used to detect
+        // cycles that would otherwise recurse until the stack overflows.
+        readonly List<object> _projecting = new List<object>();
+
+        JsValue ToJsDict(object obj, PropertyInfo[] props)
+        {
+            _nodeCount = 0;
+            _textLength = 0;
+            _projecting.Clear();
+
+            WriteDict(ReserveNodes(1), obj, props);
+
+            return JsEngine.jsvalue_from_nodes(_nodes, _text);
+        }
+
+        int ReserveNodes(int count)
+        {
+            int first = _nodeCount;
+            _nodeCount += count;
+            if (_nodeCount > _nodes.Length)
+                Array.Resize(ref _nodes, Math.Max(_nodes.Length * 2, _nodeCount));
+            return first;
+        }
+
+        void WriteString(int index, string s)
+        {
+            if (_textLength + s.Length > _text.Length)
+                Array.Resize(ref _text, Math.Max(_text.Length * 2, _textLength + s.Length));
+            s.CopyTo(0, _text, _textLength, s.Length);
+            _nodes[index] = new JsValue { Type = JsValueType.String, I32 = _textLength, Length = s.Length };
+            _textLength += s.Length;
+        }
+
+        void WriteDict(int index, object obj, PropertyInfo[] props)
+        {
+            foreach (object o in _projecting) {
+                if (Object.ReferenceEquals(o, obj))
+                    throw new JsInteropException("can't pass by value an object that references itself: " + obj.GetType());
+            }
+
+            int first = ReserveNodes(props.Length * 2);
+            _nodes[index] = new JsValue { Type = JsValueType.Dict, I32 = first, Length = props.Length };
+
+            _projecting.Add(obj);
+            for (int i=0 ; i < props.Length ; i++) {
+                WriteString(first + 2*i, props[i].Name);
+                WriteValue(first + 2*i + 1, props[i].GetValue(obj, null));
+            }
+            _projecting.RemoveAt(_projecting.Count - 1);
+        }
+
+        // Inside a projection arrays of any element type (not only object[]) are
+        // copied too, because they are part of the value.
+        void WriteValue(int index, object obj)
+        {
+            if (obj == null) {
+                _nodes[index] = JsValue.Null;
+                return;
+            }
+
+            var s = obj as string;
+            if (s != null || obj is Char) {
+                WriteString(index, s ?? obj.ToString());
+                return;
+            }
+
+            var array = obj as Array;
+            if (array != null && array.Rank == 1) {
+                int first = ReserveNodes(array.Length);
+                _nodes[index] = new JsValue { Type = JsValueType.Array, I32 = first, Length = array.Length };
+                for (int i=0 ; i < array.Length ; i++)
+                    WriteValue(first + i, array.GetValue(i));
+                return;
+            }
+
+            PropertyInfo[] props = GetProjectedProperties(obj.GetType());
+            if (props != null) {
+                WriteDict(index, obj, props);
+                return;
+            }
+
+            // Everything else (primitive values and references to CLR objects)
+            // doesn't use any unmanaged memory.
+            _nodes[index] = ToJsValue(obj);
+        }
+
         public JsValue ToJsValue(object obj)
         {
             if (obj == null)
@@ -160,6 +309,14 @@ namespace VroomJs
                 return v;
             }
 
+            // Objects projected by value are sent as a dict: an unmanaged array of
+            // key/value pairs, one for each public property, that becomes a plain
+            // JS object on the other side.
+
+            PropertyInfo[] props = GetProjectedProperties(type);
+            if (props != null)
+                return ToJsDict(obj, props);
+
             // Every object explicitly converted to a value becomes an entry of the
             // _keepalives list, to make sure the GC won't collect it while still in
             // use by the unmanaged Javascript engine. We don't try to track duplicates
@@ -24,6 +24,7 @@
 // THE SOFTWARE.
 
 using System;
+using System.Collections.Generic;
 using System.Linq;
 using System.Reflection;
 using System.Runtime.InteropServices;
@@ -48,15 +49,42 @@ namespace VroomJs
         [DllImport("vroomjs")]
         static extern void jsengine_dispose(HandleRef engine);
 
+        [DllImport("vroomjs")]
+        static extern void jsengine_get_metrics(HandleRef engine, out JsEngineMetrics metrics);
+
         [DllImport("vroomjs")]
         static extern void jsengine_force_gc();
 
         [DllImport("vroomjs")]
         static extern void jsengine_dispose_object(HandleRef engine, IntPtr obj);
 
+        [DllImport("vroomjs")]
+        static extern JsValue jsengine_iter_open(HandleRef engine, IntPtr ptr, [MarshalAs(UnmanagedType.LPWStr)] string name, out IntPtr iter);
+
+        [DllImport("vroomjs")]
+        static extern JsValue jsengine_iter_next(HandleRef engine, IntPtr iter, int count);
+
+        [DllImport("vroomjs")]
+        static extern void jsengine_iter_close(HandleRef engine, IntPtr iter);
+
+        [DllImport("vroomjs")]
+        static extern JsValue jsengine_error_get(HandleRef engine, IntPtr err, int property);
+
+        [DllImport("vroomjs")]
+        static extern void jsengine_dispose_error(HandleRef engine, IntPtr err);
+
+        [DllImport("vroomjs")]
+        static extern void jsengine_set_stack_capture_depth(HandleRef engine, int depth);
+
         [DllImport("vroomjs")]
         static extern JsValue jsengine_execute(HandleRef engine, [MarshalAs(UnmanagedType.LPWStr)] string str);
 
+        [DllImport("vroomjs")]
+        static extern JsValue jsengine_execute_file(HandleRef engine, [MarshalAs(UnmanagedType.LPStr)] string path);
+
+        [DllImport("vroomjs")]
+        static extern JsValue jsengine_load_module(HandleRef engine, [MarshalAs(UnmanagedType.LPStr)] string path);
+
         [DllImport("vroomjs")]
         static extern JsValue jsengine_get_variable(HandleRef engine, [MarshalAs(UnmanagedType.LPWStr)] string name);
 
@@ -72,12 +100,30 @@ namespace VroomJs
         [DllImport("vroomjs")]
         static extern JsValue jsengine_invoke_property(HandleRef engine, IntPtr ptr, [MarshalAs(UnmanagedType.LPWStr)] string name, JsValue args);
 
+        [DllImport("vroomjs")]
+        static extern int jsengine_set_profiler_sampling_interval(int samplingInterval);
+
+        [DllImport("vroomjs")]
+        static extern JsValue jsengine_start_profiling(HandleRef engine);
+
+        [DllImport("vroomjs")]
+        static extern JsValue jsengine_stop_profiling(HandleRef engine);
+
+        [DllImport("vroomjs")]
+        static extern JsValue jsengine_parallel_map(IntPtr[] engines, int count, [MarshalAs(UnmanagedType.LPWStr)] string function, JsValue input, int chunkSize);
+
         [DllImport("vroomjs")]
         static internal extern JsValue jsvalue_alloc_string([MarshalAs(UnmanagedType.LPWStr)] string str);
 
         [DllImport("vroomjs")]
         static internal extern JsValue jsvalue_alloc_array(int length);
 
+        [DllImport("vroomjs")]
+        static extern long jsvalue_get_allocations();
+
+        [DllImport("vroomjs", CharSet = CharSet.Unicode)]
+        static internal extern JsValue jsvalue_from_nodes(JsValue[] nodes, char[] text);
+
         [DllImport("vroomjs")]
         static internal extern void jsvalue_dispose(JsValue value);
 
@@ -112,10 +158,45 @@ namespace VroomJs
 
         public JsEngineStats GetStats()
         {
+            // After disposal only the keepalive statistics are still meaningful.
+            JsEngineMetrics m;
+            if (_disposed)
+                m = JsEngineMetrics.Empty();
+            else
+                jsengine_get_metrics(_engine, out m);
+
             return new JsEngineStats {
                 KeepAliveMaxSlots = _keepalives.MaxSlots,
                 KeepAliveAllocatedSlots = _keepalives.AllocatedSlots,
-                KeepAliveUsedSlots = _keepalives.UsedSlots
+                KeepAliveUsedSlots = _keepalives.UsedSlots,
+
+                ExecuteCalls = m.Calls[JsEngineMetrics.CallExecute],
+                GetVariableCalls = m.Calls[JsEngineMetrics.CallGetVariable],
+                SetVariableCalls = m.Calls[JsEngineMetrics.CallSetVariable],
+                GetPropertyValueCalls = m.Calls[JsEngineMetrics.CallGetPropertyValue],
+                SetPropertyValueCalls = m.Calls[JsEngineMetrics.CallSetPropertyValue],
+                InvokePropertyCalls = m.Calls[JsEngineMetrics.CallInvokeProperty],
+                DisposeObjectCalls = m.Calls[JsEngineMetrics.CallDisposeObject],
+                ExecuteFileCalls = m.Calls[JsEngineMetrics.CallExecuteFile],
+                LoadModuleCalls = m.Calls[JsEngineMetrics.CallLoadModule],
+                IterOpenCalls = m.Calls[JsEngineMetrics.CallIterOpen],
+                IterNextCalls = m.Calls[JsEngineMetrics.CallIterNext],
+                ParallelMapCalls = m.Calls[JsEngineMetrics.CallParallelMap],
+
+                KeepAliveRemoveCalls = m.ReverseCalls[JsEngineMetrics.ReverseRemove],
+                KeepAliveGetPropertyValueCalls = m.ReverseCalls[JsEngineMetrics.ReverseGetPropertyValue],
+                KeepAliveSetPropertyValueCalls = m.ReverseCalls[JsEngineMetrics.ReverseSetPropertyValue],
+                KeepAliveInvokeCalls = m.ReverseCalls[JsEngineMetrics.ReverseInvoke],
+
+                BytesToV8 = m.BytesToV8,
+                BytesFromV8 = m.BytesFromV8,
+                JsValueAllocations = m.JsValueAllocations,
+                BridgeJsValueAllocations = jsvalue_get_allocations(),
+
+                CompileLatency = m.GetLatency(JsEngineMetrics.PhaseCompile),
+                RunLatency = m.GetLatency(JsEngineMetrics.PhaseRun),
+                ToV8Latency = m.GetLatency(JsEngineMetrics.PhaseToV8),
+                FromV8Latency = m.GetLatency(JsEngineMetrics.PhaseFromV8)
             };
         }
 
@@ -136,6 +217,47 @@ namespace VroomJs
             return res;
         }
 
+        // Executes a script file. The file is memory mapped and, if plain ASCII, used
+        // by V8 without any copy; errors report the path as the script name.
+
+        public object ExecuteFile(string path)
+        {
+            if (path == null)
+                throw new ArgumentNullException("path");
+
+            CheckDisposed();
+
+            JsValue v = jsengine_execute_file(_engine, path);
+            object res = _convert.FromJsValue(v);
+            jsvalue_dispose(v);
+
+            Exception e = res as JsException;
+            if (e != null)
+                throw e;
+            return res;
+        }
+
+        // Like ExecuteFile() but the script runs only once per engine and its value
+        // (the value of the last expression) is cached and returned on subsequent
+        // calls, until the file changes on disk.
+
+        public object LoadModule(string path)
+        {
+            if (path == null)
+                throw new ArgumentNullException("path");
+
+            CheckDisposed();
+
+            JsValue v = jsengine_load_module(_engine, path);
+            object res = _convert.FromJsValue(v);
+            jsvalue_dispose(v);
+
+            Exception e = res as JsException;
+            if (e != null)
+                throw e;
+            return res;
+        }
+
         public object GetVariable(string name)
         {
             if (name == null)
@@ -153,6 +275,19 @@ namespace VroomJs
             return res;
         }
 
+        // Pass instances of the given type to Javascript by value, exactly as if
+        // it was marked with JsByValueAttribute. Only affects this engine.
+
+        public void ProjectByValue(Type type)
+        {
+            if (type == null)
+                throw new ArgumentNullException("type");
+
+            CheckDisposed();
+
+            _convert.ProjectByValue(type);
+        }
+
         public void SetVariable(string name, object value)
         {
             if (name == null)
@@ -224,13 +359,16 @@ namespace VroomJs
             if (obj.Handle == IntPtr.Zero)
                 throw new JsInteropException("wrapped V8 object is empty (IntPtr is Zero)");
 
+            if (args != null && args.Length <= InlineArgs)
+                return InvokePropertyInline(obj, name, args);
+
             JsValue a = JsValue.Null; // Null value unless we're given args.
             if (args != null)
                 a = _convert.ToJsValue(args);
 
             JsValue v = jsengine_invoke_property(_engine, obj.Handle, name, a);
             object res = _convert.FromJsValue(v);
-            jsvalue_dispose(v);
+            DisposeValue(v);
             jsvalue_dispose(a);
 
             Exception e = res as JsException;
@@ -239,6 +377,229 @@ namespace VroomJs
             return res;
         }
 
+        // Must match JSVALUE_INLINE_ARGS in vroomjs.h.
+        const int InlineArgs = 4;
+
+        // Small calls pass their arguments in slots on the stack instead of an array
+        // allocated on the unmanaged side: with primitive arguments the call doesn't
+        // allocate any unmanaged memory and doesn't need any extra P/Invoke.
+
+        unsafe object InvokePropertyInline(JsObject obj, string name, object[] args)
+        {
+            JsValue* slots = stackalloc JsValue[InlineArgs];
+            object res;
+
+            // If a conversion throws only the slots filled so far are disposed.
+            int filled = 0;
+            try {
+                for ( ; filled < args.Length ; filled++)
+                    slots[filled] = _convert.ToJsValue(args[filled]);
+
+                JsValue a = new JsValue { Type = JsValueType.Array, Length = args.Length, Ptr = (IntPtr)slots };
+
+                JsValue v = jsengine_invoke_property(_engine, obj.Handle, name, a);
+                res = _convert.FromJsValue(v);
+                DisposeValue(v);
+            }
+            finally {
+                for (int i=0 ; i < filled ; i++)
+                    DisposeValue(slots[i]);
+            }
+
+            Exception e = res as JsException;
+            if (e != null)
+                throw e;
+            return res;
+        }
+
+        // Only strings, errors, arrays and dicts own unmanaged memory: don't cross
+        // the bridge just to dispose a primitive value.
+
+        static void DisposeValue(JsValue v)
+        {
+            if (v.Type == JsValueType.String || v.Type == JsValueType.Error || 
+                v.Type == JsValueType.Array || v.Type == JsValueType.Dict)
+                jsvalue_dispose(v);
+        }
+
+        // Sets the interval (in microseconds) between CPU samples taken by the
+        // profiler. V8 keeps it as a process-wide setting so it must be set
+        // before creating the first engine.
+
+        public static void SetProfilerSamplingInterval(int samplingInterval)
+        {
+            if (samplingInterval <= 0)
+                throw new ArgumentOutOfRangeException("samplingInterval");
+
+            if (jsengine_set_profiler_sampling_interval(samplingInterval) == 0)
+                throw new InvalidOperationException("the sampling interval can't be changed after creating an engine");
+        }
+
+        // Start collecting CPU samples for the scripts running in this engine;
+        // other engines are not affected.
+
+        public void StartProfiling()
+        {
+            CheckDisposed();
+
+            JsValue v = jsengine_start_profiling(_engine);
+            object res = _convert.FromJsValue(v);
+            jsvalue_dispose(v);
+
+            Exception e = res as JsException;
+            if (e != null)
+                throw e;
+        }
+
+        public JsProfile StopProfiling()
+        {
+            CheckDisposed();
+
+            JsValue v = jsengine_stop_profiling(_engine);
+            object res = _convert.FromJsValue(v);
+            jsvalue_dispose(v);
+
+            Exception e = res as JsException;
+            if (e != null)
+                throw e;
+            return new JsProfile((object[])res);
+        }
+
+        // Lazily enumerates the elements of a big Javascript array (or the names of
+        // the own properties of any other object) stored in a global variable,
+        // converting and transferring only chunkSize elements at a time.
+
+        public IEnumerable<object> EnumerateVariable(string name)
+        {
+            return EnumerateVariable(name, DefaultChunkSize);
+        }
+
+        public IEnumerable<object> EnumerateVariable(string name, int chunkSize)
+        {
+            if (name == null)
+                throw new ArgumentNullException("name");
+            if (chunkSize <= 0)
+                throw new ArgumentOutOfRangeException("chunkSize");
+
+            return Enumerate(IntPtr.Zero, name, chunkSize);
+        }
+
+        internal const int DefaultChunkSize = 1024;
+
+        // Note that this is an iterator block: nothing happens until the caller
+        // starts enumerating and the native cursor is closed when the enumeration
+        // ends or the enumerator is disposed (i.e., at the end of a foreach). An
+        // abandoned enumerator closes it when collected (see JsIterator).
+
+        internal IEnumerable<object> Enumerate(IntPtr ptr, string name, int chunkSize)
+        {
+            CheckDisposed();
+
+            IntPtr handle;
+            JsValue status = jsengine_iter_open(_engine, ptr, name, out handle);
+            var error = _convert.FromJsValue(status) as JsException;
+            jsvalue_dispose(status);
+
+            if (error != null)
+                throw error;
+            if (handle == IntPtr.Zero)
+                throw new JsInteropException("can't enumerate a value that is not an object or an array");
+
+            var iter = new JsIterator(this, handle);
+            try {
+                while (true) {
+                    CheckDisposed();
+
+                    JsValue v = jsengine_iter_next(_engine, iter.Handle, chunkSize);
+                    object res = _convert.FromJsValue(v);
+                    jsvalue_dispose(v);
+
+                    Exception e = res as JsException;
+                    if (e != null)
+                        throw e;
+
+                    var chunk = (object[])res;
+                    if (chunk.Length == 0)
+                        yield break;
+                    foreach (object o in chunk)
+                        yield return o;
+                }
+            }
+            finally {
+                iter.Dispose();
+            }
+        }
+
+        internal void CloseIterator(JsIterator iter)
+        {
+            // Same as DisposeObject(): after the engine has been disposed we only
+            // need to release the native memory.
+            if (_disposed)
+                jsengine_iter_close(new HandleRef(this, IntPtr.Zero), iter.Handle);
+            else
+                jsengine_iter_close(_engine, iter.Handle);
+        }
+
+        // Calls function(value, index) for every value in input, splitting the work
+        // among all the given engines (one thread per engine) and returns the
+        // results in the same order. Values and results must be primitive values
+        // or arrays because they can't refer to objects living in a single engine;
+        // the first error, if any, is thrown after all values have been processed.
+
+        public static object[] ParallelMap(IList<JsEngine> engines, string function, object[] input)
+        {
+            return ParallelMap(engines, function, input, DefaultMapChunkSize);
+        }
+
+        public static object[] ParallelMap(IList<JsEngine> engines, string function, object[] input, int chunkSize)
+        {
+            if (engines == null)
+                throw new ArgumentNullException("engines");
+            if (engines.Count == 0)
+                throw new ArgumentException("at least one engine is required", "engines");
+            if (function == null)
+                throw new ArgumentNullException("function");
+            if (input == null)
+                throw new ArgumentNullException("input");
+            if (chunkSize <= 0)
+                throw new ArgumentOutOfRangeException("chunkSize");
+            if (!JsConvert.IsPortable(input))
+                throw new ArgumentException("values must be primitive values or arrays", "input");
+
+            var handles = new IntPtr[engines.Count];
+            for (int i=0 ; i < handles.Length ; i++) {
+                engines[i].CheckDisposed();
+                handles[i] = engines[i]._engine.Handle;
+            }
+
+            // Portable values don't use the keepalives so any engine can convert them.
+            JsConvert convert = engines[0]._convert;
+            JsValue a = convert.ToJsValue(input);
+            JsValue v = jsengine_parallel_map(handles, handles.Length, function, a, chunkSize);
+            jsvalue_dispose(a);
+
+            // Make sure no engine is finalized while the native threads are using it.
+            foreach (JsEngine engine in engines)
+                GC.KeepAlive(engine);
+
+            object res = convert.FromJsValue(v);
+            jsvalue_dispose(v);
+
+            Exception e = res as JsException;
+            if (e != null)
+                throw e;
+
+            var results = (object[])res;
+            foreach (object r in results) {
+                e = r as JsException;
+                if (e != null)
+                    throw e;
+            }
+            return results;
+        }
+
+        internal const int DefaultMapChunkSize = 64;
+
         public void DisposeObject(JsObject obj)
         {
             // If the engine has already been explicitly disposed we pass Zero as
@@ -250,6 +611,92 @@ namespace VroomJs
                 jsengine_dispose_object(_engine, obj.Handle);
         }
 
+        internal object GetErrorProperty(JsErrorInfo err, int property)
+        {
+            // Errors can outlive the engine: after disposal the native side still
+            // knows the message, line and column (null for everything else).
+            HandleRef engine = _disposed ? new HandleRef(this, IntPtr.Zero) : _engine;
+
+            JsValue v = jsengine_error_get(engine, err.Handle, property);
+            object res = _convert.FromJsValue(v);
+            jsvalue_dispose(v);
+            return res;
+        }
+
+        internal void DisposeError(JsErrorInfo err)
+        {
+            // Same as DisposeObject(): after the engine has been disposed we only
+            // need to release the native memory.
+            if (_disposed)
+                jsengine_dispose_error(new HandleRef(this, IntPtr.Zero), err.Handle);
+            else
+                jsengine_dispose_error(_engine, err.Handle);
+        }
+
+        // Native errors and cursors released by finalizers. The finalizer thread
+        // can't take the V8 lock (it would wait for any script running in the
+        // engine and could race with Dispose()) so they are queued here and
+        // released by the next call made on the engine or by Dispose().
+        readonly object _pendingLock = new object();
+        readonly List<IntPtr> _pendingErrors = new List<IntPtr>();
+        readonly List<IntPtr> _pendingIterators = new List<IntPtr>();
+        bool _nativeDisposed;
+
+        internal void QueueDisposeError(JsErrorInfo err)
+        {
+            if (!Queue(_pendingErrors, err.Handle))
+                jsengine_dispose_error(new HandleRef(this, IntPtr.Zero), err.Handle);
+        }
+
+        internal void QueueCloseIterator(JsIterator iter)
+        {
+            if (!Queue(_pendingIterators, iter.Handle))
+                jsengine_iter_close(new HandleRef(this, IntPtr.Zero), iter.Handle);
+        }
+
+        bool Queue(List<IntPtr> pending, IntPtr ptr)
+        {
+            lock (_pendingLock) {
+                if (_nativeDisposed)
+                    return false;
+                pending.Add(ptr);
+                return true;
+            }
+        }
+
+        void ReleasePending(HandleRef engine)
+        {
+            IntPtr[] errors, iterators;
+            lock (_pendingLock) {
+                if (_pendingErrors.Count == 0 && _pendingIterators.Count == 0)
+                    return;
+                errors = _pendingErrors.ToArray();
+                iterators = _pendingIterators.ToArray();
+                _pendingErrors.Clear();
+                _pendingIterators.Clear();
+            }
+            foreach (IntPtr err in errors)
+                jsengine_dispose_error(engine, err);
+            foreach (IntPtr iter in iterators)
+                jsengine_iter_close(engine, iter);
+        }
+
+        int _stackCaptureDepth;
+
+        // Maximum number of stack frames recorded when an exception is thrown
+        // (see JsException.StackFrames). The default, 0, doesn't capture anything.
+
+        public int StackCaptureDepth {
+            get { return _stackCaptureDepth; }
+            set {
+                if (value < 0)
+                    throw new ArgumentOutOfRangeException("value");
+                CheckDisposed();
+                jsengine_set_stack_capture_depth(_engine, value);
+                _stackCaptureDepth = value;
+            }
+        }
+
         public void Flush()
         {
             jsengine_force_gc();
@@ -349,8 +796,6 @@ namespace VroomJs
         {
             // TODO: This is pretty slow: use a cache of generated code to make it faster.
 
-            Console.WriteLine(args);
-
             var obj = KeepAliveGet(slot) as WeakDelegate;
             if (obj != null) {
                 Type type = obj.Target.GetType();
@@ -396,12 +841,24 @@ namespace VroomJs
             }
 
             jsengine_dispose(_engine);
+
+            // Errors and cursors still queued have been detached by
+            // jsengine_dispose(): only the native memory is left to free.
+            lock (_pendingLock) {
+                _nativeDisposed = true;
+            }
+            ReleasePending(new HandleRef(this, IntPtr.Zero));
         }
 
+        // Every entry point calls this first, on the thread using the engine, and
+        // that's where we release what finalizers queued (see ReleasePending).
+
         void CheckDisposed()
         {
             if (_disposed)
                 throw new ObjectDisposedException("JsEngine:" + _engine.Handle);
+
+            ReleasePending(_engine);
         }
 
         ~JsEngine()
@@ -0,0 +1,98 @@
+// This file is part of the VroomJs library.
+//
+// Author:
+//     Federico Di Gregorio <fog@initd.org>
+//
+// Copyright (c) 2013 
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+using System;
+using System.Runtime.InteropServices;
+
+namespace VroomJs
+{
+    // Mirror of jsengine_metrics in vroomjs.h; the sizes of the arrays must match
+    // the JSENGINE_*_MAX and JSENGINE_LATENCY_BUCKETS constants.
+
+    [StructLayout(LayoutKind.Sequential)]
+    struct JsEngineMetrics
+    {
+        public const int CallMax = 16;
+        public const int ReverseMax = 4;
+        public const int PhaseMax = 4;
+        public const int LatencyBuckets = 24;
+
+        // Indexes into Calls.
+        public const int CallExecute = 0;
+        public const int CallGetVariable = 1;
+        public const int CallSetVariable = 2;
+        public const int CallGetPropertyValue = 3;
+        public const int CallSetPropertyValue = 4;
+        public const int CallInvokeProperty = 5;
+        public const int CallDisposeObject = 6;
+        public const int CallExecuteFile = 7;
+        public const int CallLoadModule = 8;
+        public const int CallIterOpen = 9;
+        public const int CallIterNext = 10;
+        public const int CallParallelMap = 11;
+
+        // Indexes into ReverseCalls.
+        public const int ReverseRemove = 0;
+        public const int ReverseGetPropertyValue = 1;
+        public const int ReverseSetPropertyValue = 2;
+        public const int ReverseInvoke = 3;
+
+        // Phases, each one owns LatencyBuckets consecutive entries of Latency.
+        public const int PhaseCompile = 0;
+        public const int PhaseRun = 1;
+        public const int PhaseToV8 = 2;
+        public const int PhaseFromV8 = 3;
+
+        [MarshalAs(UnmanagedType.ByValArray, SizeConst = CallMax)]
+        public long[] Calls;
+
+        [MarshalAs(UnmanagedType.ByValArray, SizeConst = ReverseMax)]
+        public long[] ReverseCalls;
+
+        public long BytesToV8;
+        public long BytesFromV8;
+        public long JsValueAllocations;
+
+        [MarshalAs(UnmanagedType.ByValArray, SizeConst = PhaseMax*LatencyBuckets)]
+        public long[] Latency;
+
+        // All counters at zero, used when the native engine is already gone.
+        public static JsEngineMetrics Empty()
+        {
+            return new JsEngineMetrics {
+                Calls = new long[CallMax],
+                ReverseCalls = new long[ReverseMax],
+                Latency = new long[PhaseMax*LatencyBuckets]
+            };
+        }
+
+        public long[] GetLatency(int phase)
+        {
+            var r = new long[LatencyBuckets];
+            Array.Copy(Latency, phase*LatencyBuckets, r, 0, LatencyBuckets);
+            return r;
+        }
+    }
+}
@@ -32,6 +32,46 @@ namespace VroomJs
         public int KeepAliveMaxSlots { get; set; }
         public int KeepAliveAllocatedSlots { get; set; }
         public int KeepAliveUsedSlots { get; set; }
+
+        // Calls from the CLR into the native engine, by entry point.
+        public long ExecuteCalls { get; set; }
+        public long GetVariableCalls { get; set; }
+        public long SetVariableCalls { get; set; }
+        public long GetPropertyValueCalls { get; set; }
+        public long SetPropertyValueCalls { get; set; }
+        public long InvokePropertyCalls { get; set; }
+        public long DisposeObjectCalls { get; set; }
+        public long ExecuteFileCalls { get; set; }
+        public long LoadModuleCalls { get; set; }
+        public long IterOpenCalls { get; set; }
+        public long IterNextCalls { get; set; }
+        public long ParallelMapCalls { get; set; }
+
+        // Reverse calls from V8 into the CLR through the keepalive delegates.
+        public long KeepAliveRemoveCalls { get; set; }
+        public long KeepAliveGetPropertyValueCalls { get; set; }
+        public long KeepAliveSetPropertyValueCalls { get; set; }
+        public long KeepAliveInvokeCalls { get; set; }
+
+        // String bytes converted (as UTF-16) by the engine.
+        public long BytesToV8 { get; set; }
+        public long BytesFromV8 { get; set; }
+
+        // Jsvalues allocated by this engine converting V8 values for the CLR.
+        public long JsValueAllocations { get; set; }
+
+        // Calls to the jsvalue_alloc_* and jsvalue_from_nodes functions of the bridge in the whole process
+        // (not just this engine): these are mostly allocations made by the CLR to
+        // send strings, arrays, arguments and by-value objects to V8.
+        public long BridgeJsValueAllocations { get; set; }
+
+        // Latency histograms: element 0 counts operations faster than 1us, element
+        // i operations taking from 2^(i-1) to 2^i microseconds and the last one
+        // everything slower.
+        public long[] CompileLatency { get; set; }
+        public long[] RunLatency { get; set; }
+        public long[] ToV8Latency { get; set; }
+        public long[] FromV8Latency { get; set; }
     }
 }
 
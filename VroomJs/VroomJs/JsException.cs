@@ -29,7 +29,7 @@ using System.Runtime.Serialization;
 namespace VroomJs
 { 
     [Serializable]
-    public class JsException : Exception
+    public class JsException : Exception, IDisposable
 	{
         public JsException()
         {
@@ -54,10 +54,99 @@ namespace VroomJs
             _nativeException = nativeException;
         }
 
-        readonly JsObject _nativeException;
+        JsObject _nativeException;
 
         public JsObject NativeException {
-            get { return _nativeException; }
+            get { 
+                if (_nativeException == null)
+                    _nativeException = GetInfo(JsErrorInfo.Exception) as JsObject;
+                return _nativeException; 
+            }
+        }
+
+        // Errors thrown by Javascript code keep a reference to the native error and
+        // its details are converted only when (and if) one of the properties below
+        // is read. Frames are available only if JsEngine.StackCaptureDepth > 0.
+
+        internal JsException(JsErrorInfo info)
+        {
+            _info = info;
+        }
+
+        [NonSerialized]
+        readonly JsErrorInfo _info;
+
+        [NonSerialized]
+        object[] _values;
+
+        static readonly object NotFetched = new object();
+
+        object GetInfo(int property)
+        {
+            if (_info == null)
+                return null;
+
+            if (_values == null) {
+                _values = new object[JsErrorInfo.Exception+1];
+                for (int i=0 ; i < _values.Length ; i++)
+                    _values[i] = NotFetched;
+            }
+            if (_values[property] == NotFetched)
+                _values[property] = _info.Get(property);
+            return _values[property];
+        }
+
+        // Releases the native error right away instead of when the exception is
+        // collected; after that only the properties already read are available.
+
+        public void Dispose()
+        {
+            if (_info != null)
+                _info.Dispose();
+        }
+
+        public override string Message {
+            get { return (GetInfo(JsErrorInfo.Message) as string) ?? base.Message; }
+        }
+
+        public string ScriptName {
+            get { return GetInfo(JsErrorInfo.ScriptName) as string; }
+        }
+
+        public int Line {
+            get { return (GetInfo(JsErrorInfo.Line) as int?) ?? 0; }
+        }
+
+        public int Column {
+            get { return (GetInfo(JsErrorInfo.Column) as int?) ?? 0; }
+        }
+
+        public string SourceLine {
+            get { return GetInfo(JsErrorInfo.SourceLine) as string; }
+        }
+
+        public string JsStackTrace {
+            get { return GetInfo(JsErrorInfo.Stack) as string; }
+        }
+
+        public JsStackFrame[] StackFrames {
+            get {
+                var frames = GetInfo(JsErrorInfo.Frames) as object[];
+                if (frames == null)
+                    return new JsStackFrame[0];
+
+                var r = new JsStackFrame[frames.Length];
+                for (int i=0 ; i < frames.Length ; i++) {
+                    var f = (object[])frames[i];
+                    r[i] = new JsStackFrame {
+                        FunctionName = f[0] as string,
+                        ScriptName = f[1] as string,
+                        Line = (int)f[2],
+                        Column = (int)f[3]
+                    };
+                }
+                return r;
+            }
         }
     }
 }
@@ -0,0 +1,71 @@
+// This file is part of the VroomJs library.
+//
+// Author:
+//     Federico Di Gregorio <fog@initd.org>
+//
+// Copyright (c) 2013 
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+using System;
+
+namespace VroomJs
+{
+    // Wraps the native cursor used by JsEngine.Enumerate(). It is closed when
+    // the enumeration ends but enumerators can be abandoned without disposing
+    // them, so the finalizer makes sure it is eventually closed too.
+
+    class JsIterator : IDisposable
+    {
+        public JsIterator(JsEngine engine, IntPtr ptr)
+        {
+            if (engine == null)
+                throw new ArgumentNullException("engine");
+            if (ptr == IntPtr.Zero)
+                throw new ArgumentException("can't wrap an empty cursor (ptr is Zero)", "ptr");
+
+            _engine = engine;
+            _handle = ptr;
+        }
+
+        readonly JsEngine _engine;
+        readonly IntPtr _handle;
+
+        public IntPtr Handle {
+            get { return _handle; }
+        }
+
+        bool _disposed;
+
+        public void Dispose()
+        {
+            if (_disposed)
+                return;
+
+            _disposed = true;
+            _engine.CloseIterator(this);
+            GC.SuppressFinalize(this);
+        }
+
+        ~JsIterator()
+        {
+            _engine.QueueCloseIterator(this);
+        }
+    }
+}
@@ -24,11 +24,13 @@
 // THE SOFTWARE.
 
 using System;
+using System.Collections;
+using System.Collections.Generic;
 using System.Dynamic;
 
 namespace VroomJs
 {
-    public class JsObject : DynamicObject
+    public class JsObject : DynamicObject, IEnumerable<object>
     {
         public JsObject(JsEngine engine, IntPtr ptr)
         {
@@ -66,6 +68,45 @@ namespace VroomJs
             return true;
         }
 
+        // Enumerating a JsObject returns the elements of wrapped arrays and the names
+        // of the own properties of any other object, fetched in chunks.
+
+        public IEnumerable<object> Enumerate(int chunkSize)
+        {
+            if (chunkSize <= 0)
+                throw new ArgumentOutOfRangeException("chunkSize");
+
+            return _engine.Enumerate(_handle, null, chunkSize);
+        }
+
+        // Same, for the value of one of the object properties (usually an array,
+        // that would be converted as a whole by GetPropertyValue).
+
+        public IEnumerable<object> EnumerateProperty(string name)
+        {
+            return EnumerateProperty(name, JsEngine.DefaultChunkSize);
+        }
+
+        public IEnumerable<object> EnumerateProperty(string name, int chunkSize)
+        {
+            if (name == null)
+                throw new ArgumentNullException("name");
+            if (chunkSize <= 0)
+                throw new ArgumentOutOfRangeException("chunkSize");
+
+            return _engine.Enumerate(_handle, name, chunkSize);
+        }
+
+        public IEnumerator<object> GetEnumerator()
+        {
+            return Enumerate(JsEngine.DefaultChunkSize).GetEnumerator();
+        }
+
+        IEnumerator IEnumerable.GetEnumerator()
+        {
+            return GetEnumerator();
+        }
+
         #region IDisposable implementation
 
         bool _disposed;
@@ -0,0 +1,84 @@
+// This file is part of the VroomJs library.
+//
+// Author:
+//     Federico Di Gregorio <fog@initd.org>
+//
+// Copyright (c) 2013 
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+using System;
+using System.Collections.Generic;
+using System.IO;
+
+namespace VroomJs
+{
+    // A CPU profile as returned by JsEngine.StopProfiling(): a flat list of the
+    // nodes of the call tree in depth-first order (the root comes first).
+
+    public class JsProfile
+    {
+        internal JsProfile(object[] nodes)
+        {
+            var list = new List<JsProfileNode>(nodes.Length);
+            foreach (object[] n in nodes) {
+                list.Add(new JsProfileNode {
+                    FunctionName = (string)n[0],
+                    ScriptName = (string)n[1],
+                    Line = (int)n[2],
+                    SelfSamples = (int)n[3],
+                    TotalSamples = (int)n[4],
+                    Parent = (int)n[5]
+                });
+            }
+            _nodes = list.AsReadOnly();
+        }
+
+        readonly IList<JsProfileNode> _nodes;
+
+        public IList<JsProfileNode> Nodes {
+            get { return _nodes; }
+        }
+
+        // Writes the profile in the "folded stacks" format (one line per stack,
+        // frames separated by ';' followed by the sample count) understood by
+        // most flame graph tools. The synthetic root node is omitted.
+
+        public void WriteFoldedStacks(TextWriter writer)
+        {
+            if (writer == null)
+                throw new ArgumentNullException("writer");
+
+            var stacks = new string[_nodes.Count];
+            for (int i=0 ; i < _nodes.Count ; i++) {
+                JsProfileNode n = _nodes[i];
+                if (n.Parent < 0)
+                    continue;
+
+                string frame = String.Format("{0} {1}:{2}",
+                    String.IsNullOrEmpty(n.FunctionName) ? "(anonymous)" : n.FunctionName, n.ScriptName, n.Line);
+                string parent = stacks[n.Parent];
+                stacks[i] = parent == null ? frame : parent + ";" + frame;
+
+                if (n.SelfSamples > 0)
+                    writer.WriteLine("{0} {1}", stacks[i], n.SelfSamples);
+            }
+        }
+    }
+}
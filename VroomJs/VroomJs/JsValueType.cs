@@ -42,6 +42,8 @@ namespace VroomJs
         Managed = 12,
         ManagedError = 13,
         Wrapped = 14,
-        WrappedError = 15
+        WrappedError = 15,
+        ErrorInfo = 16,
+        Dict = 17
     }
 }
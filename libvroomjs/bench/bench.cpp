@@ -0,0 +1,542 @@
+// This file is part of the VroomJs library.
+//
+// Author:
+//     Federico Di Gregorio <fog@initd.org>
+//
+// Copyright © 2013 Federico Di Gregorio <fog@initd.org>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+// Native benchmarks for the bridge layer. This program drives the same
+// extern "C" API the CLR uses through P/Invoke, with a tiny stand-in for the
+// managed side (the four keepalive_* delegates) written in plain C++, so that
+// the numbers don't include the cost of the CLR marshaler. Results are printed
+// one JSON object per line; an optional argument filters benchmarks by name.
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "vroomjs.h"
+
+extern "C"
+{
+    JsEngine* jsengine_new(keepalive_remove_f keepalive_remove, 
+                           keepalive_get_property_value_f keepalive_get_property_value,
+                           keepalive_set_property_value_f keepalive_set_property_value,
+                           keepalive_invoke_f keepalive_invoke);
+    void jsengine_dispose(JsEngine* engine);
+    void jsengine_dispose_object(JsEngine* engine, Persistent<Object>* obj);
+    jsvalue jsengine_execute(JsEngine* engine, const uint16_t* str);
+    jsvalue jsengine_set_variable(JsEngine* engine, const uint16_t* name, jsvalue value);
+    jsvalue jsengine_get_variable(JsEngine* engine, const uint16_t* name);
+    jsvalue jsengine_get_property_value(JsEngine* engine, Persistent<Object>* obj, const uint16_t* name);
+    jsvalue jsengine_set_property_value(JsEngine* engine, Persistent<Object>* obj, const uint16_t* name, jsvalue value);
+    jsvalue jsengine_invoke_property(JsEngine* engine, Persistent<Object>* obj, const uint16_t* name, jsvalue args);
+    jsvalue jsengine_parallel_map(JsEngine** engines, int32_t count, const uint16_t* function,
+                                  jsvalue input, int32_t chunk_size);
+    jsvalue jsvalue_alloc_string(const uint16_t* str);
+    jsvalue jsvalue_alloc_array(const int32_t length);
+    jsvalue jsvalue_from_nodes(const jsvalue* nodes, const uint16_t* text);
+}
+
+// Converts an ASCII C string to the UTF-16 strings used by the bridge.
+
+class U16 {
+ public:
+    explicit U16(const char* s) {
+        size_t length = strlen(s);
+        str_ = new uint16_t[length+1];
+        for (size_t i=0 ; i <= length ; i++)
+            str_[i] = s[i];
+    }
+    ~U16() { delete[] str_; }
+    inline operator uint16_t*() const { return str_; }
+ private:
+    uint16_t* str_;
+};
+
+static bool u16_equals(const uint16_t* a, const char* b)
+{
+    while (*a != 0 && *a == *b) {
+        a++;
+        b++;
+    }
+    return *a == *b;
+}
+
+static uint64_t now_nsecs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static inline jsvalue make_integer(int32_t i)
+{
+    jsvalue v;
+    v.type = JSVALUE_TYPE_INTEGER;
+    v.value.i32 = i;
+    v.length = 0;
+    return v;
+}
+
+static inline jsvalue make_null()
+{
+    jsvalue v;
+    v.type = JSVALUE_TYPE_NULL;
+    v.value.i64 = 0;
+    v.length = 0;
+    return v;
+}
+
+static inline jsvalue make_managed(int32_t slot)
+{
+    jsvalue v;
+    v.type = JSVALUE_TYPE_MANAGED;
+    v.value.i64 = 0;
+    v.length = slot;
+    return v;
+}
+
+// The stand-in CLR host. Slot STUB_OBJECT is an object with an integer
+// property "value", properties "f0" ... "fN" returning N and a method "add"
+// (returned, as the CLR does, as a reference to a callable object in slot
+// STUB_METHOD) that sums its integer arguments.
+
+#define STUB_OBJECT 1
+#define STUB_METHOD 2
+
+static int64_t stub_removed = 0;
+static int32_t stub_value = 0;
+
+static void stub_remove(int id)
+{
+    stub_removed++;
+}
+
+static jsvalue stub_get_property_value(int id, uint16_t* name)
+{
+    if (id != STUB_OBJECT)
+        return make_null();
+    if (u16_equals(name, "value"))
+        return make_integer(stub_value);
+    if (u16_equals(name, "add"))
+        return make_managed(STUB_METHOD);
+    if (name[0] == 'f') {
+        int32_t n = 0;
+        for (uint16_t* c = name+1 ; *c >= '0' && *c <= '9' ; c++)
+            n = n*10 + (*c - '0');
+        return make_integer(n);
+    }
+    return make_null();
+}
+
+static jsvalue stub_set_property_value(int id, uint16_t* name, jsvalue value)
+{
+    if (id == STUB_OBJECT && value.type == JSVALUE_TYPE_INTEGER && u16_equals(name, "value"))
+        stub_value = value.value.i32;
+    return make_null();
+}
+
+static jsvalue stub_invoke(int id, jsvalue args)
+{
+    int32_t sum = 0;
+    if (id == STUB_METHOD && args.type == JSVALUE_TYPE_ARRAY) {
+        for (int i=0 ; i < args.length ; i++) {
+            if (args.value.arr[i].type == JSVALUE_TYPE_INTEGER)
+                sum += args.value.arr[i].value.i32;
+        }
+    }
+    return make_integer(sum);
+}
+
+static JsEngine* new_engine()
+{
+    return jsengine_new(stub_remove, stub_get_property_value, stub_set_property_value, stub_invoke);
+}
+
+// Benchmark driver. Each benchmark runs a warm-up pass and then "iterations"
+// iterations; "ops" is the number of operations done by a single iteration
+// (e.g., reverse calls made by one script run) and is used to report the cost
+// of a single operation.
+
+typedef void (*bench_f)(void* state);
+
+static const char* filter = NULL;
+
+static void run(const char* name, bench_f f, void* state, int iterations, int ops = 1)
+{
+    if (filter != NULL && strstr(name, filter) == NULL)
+        return;
+    
+    for (int i=0 ; i < iterations/10 + 1 ; i++)
+        f(state);
+    
+    uint64_t start = now_nsecs();
+    for (int i=0 ; i < iterations ; i++)
+        f(state);
+    uint64_t elapsed = now_nsecs() - start;
+    
+    printf("{\"benchmark\": \"%s\", \"iterations\": %d, \"ops\": %lld, \"total_ns\": %llu, \"ns_per_op\": %.1f}\n",
+           name, iterations, (long long)iterations * ops, (unsigned long long)elapsed,
+           (double)elapsed / ((double)iterations * ops));
+    fflush(stdout);
+}
+
+struct BenchState {
+    JsEngine* engine;
+    uint16_t* script;
+    jsvalue value;
+    Persistent<Object>* obj;
+    JsEngine** engines;
+    int32_t count;
+    uint16_t** keys;
+};
+
+static void bench_engine_new(void* state)
+{
+    jsengine_dispose(new_engine());
+}
+
+static void bench_execute(void* state)
+{
+    BenchState* s = (BenchState*)state;
+    jsvalue_dispose(jsengine_execute(s->engine, s->script));
+}
+
+static U16 name_x("x");
+static U16 name_f("f");
+static U16 name_value("value");
+
+// Round-trips s->value through a global variable: CLR -> V8 -> CLR.
+
+static void bench_roundtrip(void* state)
+{
+    BenchState* s = (BenchState*)state;
+    jsvalue_dispose(jsengine_set_variable(s->engine, name_x, s->value));
+    jsvalue_dispose(jsengine_get_variable(s->engine, name_x));
+}
+
+static void bench_property_get(void* state)
+{
+    BenchState* s = (BenchState*)state;
+    jsvalue_dispose(jsengine_get_property_value(s->engine, s->obj, name_value));
+}
+
+static void bench_property_set(void* state)
+{
+    BenchState* s = (BenchState*)state;
+    jsvalue_dispose(jsengine_set_property_value(s->engine, s->obj, name_value, make_integer(42)));
+}
+
+static void bench_property_invoke(void* state)
+{
+    BenchState* s = (BenchState*)state;
+    jsvalue_dispose(jsengine_invoke_property(s->engine, s->obj, name_f, s->value));
+}
+
+// CLR -> JS calls with two arguments, passed as the CLR does: either in an
+// array allocated for each call or in inline slots (see JSVALUE_INLINE_ARGS).
+
+static void bench_property_invoke_heap(void* state)
+{
+    BenchState* s = (BenchState*)state;
+    jsvalue args = jsvalue_alloc_array(2);
+    args.value.arr[0] = make_integer(40);
+    args.value.arr[1] = make_integer(2);
+    jsvalue_dispose(jsengine_invoke_property(s->engine, s->obj, name_f, args));
+    jsvalue_dispose(args);
+}
+
+static void bench_property_invoke_inline(void* state)
+{
+    BenchState* s = (BenchState*)state;
+    jsvalue slots[JSVALUE_INLINE_ARGS];
+    jsvalue args;
+    args.type = JSVALUE_TYPE_ARRAY;
+    args.length = 2;
+    args.value.arr = slots;
+    slots[0] = make_integer(40);
+    slots[1] = make_integer(2);
+    jsvalue_dispose(jsengine_invoke_property(s->engine, s->obj, name_f, args));
+}
+
+// Passes s->value to a script that reads its fields, as the CLR does when
+// calling a function with an object argument.
+
+static U16 name_o("o");
+
+static void bench_read_fields(void* state)
+{
+    BenchState* s = (BenchState*)state;
+    jsvalue_dispose(jsengine_set_variable(s->engine, name_o, s->value));
+    jsvalue_dispose(jsengine_execute(s->engine, s->script));
+}
+
+// The same, but building s->count fields projected by value exactly as
+// JsConvert does for each call: the nodes and the text of the property names
+// are written to caller memory and copied with a single jsvalue_from_nodes.
+
+static const int max_fields = 32;
+
+static void bench_read_fields_by_value(void* state)
+{
+    BenchState* s = (BenchState*)state;
+    jsvalue nodes[1 + 2*max_fields];
+    uint16_t text[16*max_fields];
+    int32_t length = 0;
+    
+    nodes[0].type = JSVALUE_TYPE_DICT;
+    nodes[0].value.i32 = 1;
+    nodes[0].length = s->count;
+    for (int i=0 ; i < s->count ; i++) {
+        jsvalue* key = &nodes[1 + 2*i];
+        key->type = JSVALUE_TYPE_STRING;
+        key->value.i32 = length;
+        for (const uint16_t* c = s->keys[i] ; *c ; c++)
+            text[length++] = *c;
+        key->length = length - key->value.i32;
+        nodes[2 + 2*i] = make_integer(i);
+    }
+    
+    jsvalue dict = jsvalue_from_nodes(nodes, text);
+    jsvalue_dispose(jsengine_set_variable(s->engine, name_o, dict));
+    jsvalue_dispose(jsengine_execute(s->engine, s->script));
+    jsvalue_dispose(dict);
+}
+
+static void bench_parallel_map(void* state)
+{
+    BenchState* s = (BenchState*)state;
+    jsvalue_dispose(jsengine_parallel_map(s->engines, s->count, s->script, s->value, 64));
+}
+
+static void bench_scripts(JsEngine* engine)
+{
+    BenchState s;
+    s.engine = engine;
+    
+    U16 trivial("1");
+    s.script = trivial;
+    run("execute_trivial", bench_execute, &s, 100000);
+    
+    U16 heavy("(function () { var s = 0; for (var i=0 ; i < 1000000 ; i++) s += i % 7; return s; })()");
+    s.script = heavy;
+    run("execute_heavy", bench_execute, &s, 50);
+}
+
+static void bench_strings(JsEngine* engine)
+{
+    static const int sizes[] = { 16, 1024, 65536 };
+    static const int iterations[] = { 100000, 20000, 500 };
+    
+    BenchState s;
+    s.engine = engine;
+    
+    for (int i=0 ; i < 3 ; i++) {
+        uint16_t* str = new uint16_t[sizes[i]+1];
+        for (int j=0 ; j < sizes[i] ; j++)
+            str[j] = 'a' + j % 26;
+        str[sizes[i]] = 0;
+        s.value = jsvalue_alloc_string(str);
+        delete[] str;
+        
+        char name[64];
+        snprintf(name, sizeof(name), "string_roundtrip_%d", sizes[i]);
+        run(name, bench_roundtrip, &s, iterations[i]);
+        jsvalue_dispose(s.value);
+    }
+}
+
+static void bench_arrays(JsEngine* engine)
+{
+    static const int sizes[] = { 16, 1024, 65536 };
+    static const int iterations[] = { 50000, 2000, 20 };
+    
+    BenchState s;
+    s.engine = engine;
+    
+    for (int i=0 ; i < 3 ; i++) {
+        s.value = jsvalue_alloc_array(sizes[i]);
+        for (int j=0 ; j < sizes[i] ; j++)
+            s.value.value.arr[j] = make_integer(j);
+        
+        char name[64];
+        snprintf(name, sizeof(name), "array_roundtrip_%d", sizes[i]);
+        run(name, bench_roundtrip, &s, iterations[i]);
+        jsvalue_dispose(s.value);
+    }
+}
+
+static void bench_properties(JsEngine* engine)
+{
+    BenchState s;
+    s.engine = engine;
+    
+    U16 script("({ value: 1, f: function (a) { return a + this.value; } })");
+    jsvalue o = jsengine_execute(engine, script);
+    if (o.type != JSVALUE_TYPE_WRAPPED) {
+        fprintf(stderr, "can't create the test object (type %d)\n", o.type);
+        jsvalue_dispose(o);
+        return;
+    }
+    s.obj = (Persistent<Object>*)o.value.ptr;
+    
+    run("property_get", bench_property_get, &s, 100000);
+    run("property_set", bench_property_set, &s, 100000);
+    
+    s.value = jsvalue_alloc_array(1);
+    s.value.value.arr[0] = make_integer(41);
+    run("property_invoke", bench_property_invoke, &s, 100000);
+    jsvalue_dispose(s.value);
+    
+    run("property_invoke_heap_args", bench_property_invoke_heap, &s, 100000);
+    run("property_invoke_inline_args", bench_property_invoke_inline, &s, 100000);
+    
+    jsengine_dispose_object(engine, s.obj);
+}
+
+static void bench_reverse_calls(JsEngine* engine)
+{
+    static const int calls = 10000;
+    
+    BenchState s;
+    s.engine = engine;
+    
+    U16 m("m");
+    jsvalue_dispose(jsengine_set_variable(engine, m, make_managed(STUB_OBJECT)));
+    
+    U16 get("(function () { var s = 0; for (var i=0 ; i < 10000 ; i++) s += m.value; return s; })()");
+    s.script = get;
+    run("reverse_get_property", bench_execute, &s, 20, calls);
+    
+    U16 set("(function () { for (var i=0 ; i < 10000 ; i++) m.value = i; })()");
+    s.script = set;
+    run("reverse_set_property", bench_execute, &s, 20, calls);
+    
+    // Each call is really two reverse calls: one to get the method and one to
+    // invoke it, exactly as it happens with a real CLR object.
+    U16 invoke("(function () { var s = 0; for (var i=0 ; i < 10000 ; i++) s += m.add(i, 1); return s; })()");
+    s.script = invoke;
+    run("reverse_invoke", bench_execute, &s, 20, calls);
+    
+    // Callback-heavy scripts by arity: up to JSVALUE_INLINE_ARGS arguments go
+    // in inline slots, above that through a heap allocated array.
+    static const char* arity_calls[] = { "m.add()", "m.add(i)", "m.add(i, 1)", "m.add(i, 1, 2)", 
+                                         "m.add(i, 1, 2, 3)", "m.add(i, 1, 2, 3, 4)" };
+    for (int i=0 ; i < 6 ; i++) {
+        char script[256], name[64];
+        snprintf(script, sizeof(script), 
+                 "(function () { var s = 0; for (var i=0 ; i < 10000 ; i++) s += %s; return s; })()", arity_calls[i]);
+        snprintf(name, sizeof(name), "reverse_invoke_arity_%d", i);
+        U16 code(script);
+        s.script = code;
+        run(name, bench_execute, &s, 20, calls);
+    }
+}
+
+// Reading 20 fields of a CLR object, through the interceptors (one reverse
+// call for each field) and projected by value (see JsByValueAttribute), that
+// pays for building the dict instead.
+
+static void bench_by_value(JsEngine* engine)
+{
+    static const int fields = 20;
+    
+    BenchState s;
+    s.engine = engine;
+    
+    char script[512] = "o.f0";
+    for (int i=1 ; i < fields ; i++) {
+        char field[16];
+        snprintf(field, sizeof(field), " + o.f%d", i);
+        strcat(script, field);
+    }
+    U16 code(script);
+    s.script = code;
+    
+    s.value = make_managed(STUB_OBJECT);
+    run("read_fields_interceptors_20", bench_read_fields, &s, 20000, fields);
+    
+    uint16_t* keys[fields];
+    for (int i=0 ; i < fields ; i++) {
+        char key[16];
+        int length = snprintf(key, sizeof(key), "f%d", i);
+        keys[i] = new uint16_t[length+1];
+        for (int j=0 ; j <= length ; j++)
+            keys[i][j] = key[j];
+    }
+    s.keys = keys;
+    s.count = fields;
+    run("read_fields_by_value_20", bench_read_fields_by_value, &s, 20000, fields);
+    for (int i=0 ; i < fields ; i++)
+        delete[] keys[i];
+}
+
+// The same CPU bound map over 4096 values run by 1, 2 and 4 engines, to see
+// how parallel_map scales with the number of cores.
+
+static void bench_parallel()
+{
+    static const int length = 4096;
+    
+    BenchState s;
+    JsEngine* engines[4];
+    for (int i=0 ; i < 4 ; i++)
+        engines[i] = new_engine();
+    s.engines = engines;
+    
+    U16 function("function (x) { var s = 0; for (var i=0 ; i < 1000 ; i++) s += (x + i) % 7; return s; }");
+    s.script = function;
+    s.value = jsvalue_alloc_array(length);
+    for (int i=0 ; i < length ; i++)
+        s.value.value.arr[i] = make_integer(i);
+    
+    for (s.count = 1 ; s.count <= 4 ; s.count *= 2) {
+        char name[64];
+        snprintf(name, sizeof(name), "parallel_map_%d", s.count);
+        run(name, bench_parallel_map, &s, 10, length);
+    }
+    
+    jsvalue_dispose(s.value);
+    for (int i=0 ; i < 4 ; i++)
+        jsengine_dispose(engines[i]);
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc > 1)
+        filter = argv[1];
+    
+    run("engine_new", bench_engine_new, NULL, 20);
+    
+    JsEngine* engine = new_engine();
+    bench_scripts(engine);
+    bench_strings(engine);
+    bench_arrays(engine);
+    bench_properties(engine);
+    bench_reverse_calls(engine);
+    bench_by_value(engine);
+    jsengine_dispose(engine);
+    
+    bench_parallel();
+    
+    return 0;
+}
@@ -23,10 +23,18 @@
 // OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
 // THE SOFTWARE.
 
+#include <string.h>
 #include "vroomjs.h"
 
 using namespace v8;
 
+// Process-wide count of jsvalue_alloc_string(), jsvalue_alloc_array() and
+// jsvalue_from_nodes() calls:
+// most of them come from the CLR (strings, arrays, arguments and dicts sent to
+// V8) that the per-engine counters can't see.
+
+static int64_t bridge_allocs = 0;
+
 extern "C" 
 {
     JsEngine* jsengine_new(keepalive_remove_f keepalive_remove, 
@@ -57,6 +65,53 @@ extern "C"
         delete obj;
     }     
     
+    void jsengine_get_metrics(JsEngine* engine, jsengine_metrics* metrics)
+    {
+        engine->GetMetrics(metrics);
+    }
+    
+    jsvalue jsengine_iter_open(JsEngine* engine, Persistent<Object>* obj, const uint16_t* name, JsIterator** iter)
+    {
+        return engine->IterOpen(obj, name, iter);
+    }
+    
+    jsvalue jsengine_iter_next(JsEngine* engine, JsIterator* iter, int32_t count)
+    {
+        return engine->IterNext(iter, count);
+    }
+    
+    void jsengine_iter_close(JsEngine* engine, JsIterator* iter)
+    {
+        if (engine != NULL)
+            engine->IterClose(iter);
+        delete iter;
+    }
+    
+    jsvalue jsengine_error_get(JsEngine* engine, JsErrorInfo* err, int32_t property)
+    {
+        if (engine == NULL)
+            return err->GetDetached(property);
+        return engine->GetErrorProperty(err, property);
+    }
+    
+    void jsengine_dispose_error(JsEngine* engine, JsErrorInfo* err)
+    {
+        if (engine != NULL)
+            engine->DisposeError(err);
+        delete err;
+    }
+    
+    void jsengine_set_stack_capture_depth(JsEngine* engine, int32_t depth)
+    {
+        engine->SetStackCaptureDepth(depth);
+    }
+    
+    jsvalue jsengine_parallel_map(JsEngine** engines, int32_t count, const uint16_t* function,
+                                  jsvalue input, int32_t chunk_size)
+    {
+        return JsEngine::ParallelMap(engines, count, function, input, chunk_size);
+    }
+    
     void jsengine_force_gc()
     {
         while(!V8::IdleNotification()) {};
@@ -67,6 +122,16 @@ extern "C"
         return engine->Execute(str);
     }
         
+    jsvalue jsengine_execute_file(JsEngine* engine, const char* path)
+    {
+        return engine->ExecuteFile(path);
+    }
+    
+    jsvalue jsengine_load_module(JsEngine* engine, const char* path)
+    {
+        return engine->LoadModule(path);
+    }
+        
     jsvalue jsengine_set_variable(JsEngine* engine, const uint16_t* name, jsvalue value)
     {
         return engine->SetVariable(name, value);
@@ -92,10 +157,32 @@ extern "C"
         return engine->InvokeProperty(obj, name, args);
     }        
 
+    int32_t jsengine_set_profiler_sampling_interval(int32_t sampling_interval)
+    {
+        return JsEngine::SetProfilerSamplingInterval(sampling_interval) ? 1 : 0;
+    }
+    
+    jsvalue jsengine_start_profiling(JsEngine* engine)
+    {
+        return engine->StartProfiling();
+    }
+    
+    jsvalue jsengine_stop_profiling(JsEngine* engine)
+    {
+        return engine->StopProfiling();
+    }
+    
+    int64_t jsvalue_get_allocations()
+    {
+        return __sync_fetch_and_add(&bridge_allocs, 0);
+    }
+    
     jsvalue jsvalue_alloc_string(const uint16_t* str)
     {
         jsvalue v;
     
+        __sync_fetch_and_add(&bridge_allocs, 1);
+    
         int length = 0;
         while (str[length] != '\0')
             length++;
@@ -112,10 +199,41 @@ extern "C"
         return v;
     }    
     
+    // Copies a tree of values built by the CLR in its own memory (a projection
+    // by value, see JsConvert) in one call: strings, arrays and dicts use
+    // value.i32 as the offset of their characters in text or of their first
+    // child in nodes; the root is nodes[0].
+    
+    static jsvalue copy_node(const jsvalue& node, const jsvalue* nodes, const uint16_t* text)
+    {
+        jsvalue v = node;
+        
+        if (node.type == JSVALUE_TYPE_STRING) {
+            v.value.str = new uint16_t[node.length+1];
+            memcpy(v.value.str, text + node.value.i32, node.length * sizeof(uint16_t));
+            v.value.str[node.length] = '\0';
+        }
+        else if (node.type == JSVALUE_TYPE_ARRAY || node.type == JSVALUE_TYPE_DICT) {
+            int32_t count = node.type == JSVALUE_TYPE_DICT ? node.length*2 : node.length;
+            v.value.arr = new jsvalue[count];
+            for (int i=0 ; i < count ; i++)
+                v.value.arr[i] = copy_node(nodes[node.value.i32 + i], nodes, text);
+        }
+        
+        return v;
+    }
+    
+    jsvalue jsvalue_from_nodes(const jsvalue* nodes, const uint16_t* text)
+    {
+        __sync_fetch_and_add(&bridge_allocs, 1);
+        return copy_node(nodes[0], nodes, text);
+    }
+    
     jsvalue jsvalue_alloc_array(const int32_t length)
     {
         jsvalue v;
           
+        __sync_fetch_and_add(&bridge_allocs, 1);
         v.value.arr = new jsvalue[length];
         if (v.value.arr != NULL) {
             v.length = length;
@@ -137,5 +255,11 @@ extern "C"
             if (value.value.arr != NULL)
                 delete value.value.arr;
         }            
+        else if (value.type == JSVALUE_TYPE_DICT) {
+            for (int i=0 ; i < value.length*2 ; i++)
+                jsvalue_dispose(value.value.arr[i]);
+            if (value.value.arr != NULL)
+                delete value.value.arr;
+        }
     }       
 }
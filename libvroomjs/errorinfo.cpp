@@ -0,0 +1,131 @@
+// This file is part of the VroomJs library.
+//
+// Author:
+//     Federico Di Gregorio <fog@initd.org>
+//
+// Copyright © 2013 Federico Di Gregorio <fog@initd.org>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include <stdio.h>
+
+#include "vroomjs.h"
+
+using namespace v8;
+
+extern "C" jsvalue jsvalue_alloc_string(const uint16_t* str);
+
+JsErrorInfo::JsErrorInfo(Handle<Value> exception, Handle<Message> message)
+    : line_(0), column_(0), text_(NULL)
+{
+    exception_ = Persistent<Value>::New(exception);
+    if (!message.IsEmpty()) {
+        message_ = Persistent<Message>::New(message);
+        line_ = message->GetLineNumber();
+        // V8 columns are zero-based, stack frame ones aren't: be consistent.
+        column_ = message->GetStartColumn() + 1;
+    }
+}
+
+Handle<Value> JsErrorInfo::GetStackText()
+{
+    HandleScope scope;
+    
+    if (exception_->IsObject()) {
+        Local<Value> stack = exception_->ToObject()->Get(String::New("stack"));
+        if (!stack.IsEmpty() && stack->IsString())
+            return scope.Close(stack);
+    }
+    
+    if (message_.IsEmpty())
+        return Undefined();
+        
+    Handle<StackTrace> trace = message_->GetStackTrace();
+    if (trace.IsEmpty() || trace->GetFrameCount() == 0)
+        return Undefined();
+    
+    // Same format used by V8 for the "stack" property of Error objects. Note
+    // that toString() can throw, leaving us without a message.
+    
+    Local<String> text = exception_->ToString();
+    if (text.IsEmpty())
+        return Undefined();
+    for (int i=0 ; i < trace->GetFrameCount() ; i++) {
+        Local<StackFrame> frame = trace->GetFrame(i);
+        Local<String> function = frame->GetFunctionName();
+        if (function.IsEmpty() || function->Length() == 0)
+            function = String::New("<anonymous>");
+        Local<String> script = frame->GetScriptName();
+        if (script.IsEmpty())
+            script = String::New("<unknown>");
+        
+        char position[32];
+        snprintf(position, sizeof(position), ":%d:%d)", frame->GetLineNumber(), frame->GetColumn());
+        
+        text = String::Concat(text, String::New("\n    at "));
+        text = String::Concat(text, function);
+        text = String::Concat(text, String::New(" ("));
+        text = String::Concat(text, script);
+        text = String::Concat(text, String::New(position));
+    }
+    
+    return scope.Close(text);
+}
+
+void JsErrorInfo::Detach()
+{
+    HandleScope scope;
+    TryCatch trycatch;
+    
+    Local<String> s = exception_->ToString();
+    if (!s.IsEmpty()) {
+        text_ = new uint16_t[s->Length()+1];
+        s->Write(text_);
+    }
+    
+    Dispose();
+}
+
+jsvalue JsErrorInfo::GetDetached(int32_t property)
+{
+    jsvalue v;
+    
+    if (property == JSERROR_LINE || property == JSERROR_COLUMN) {
+        v.type = JSVALUE_TYPE_INTEGER;
+        v.value.i32 = property == JSERROR_LINE ? line_ : column_;
+        v.length = 0;
+    }
+    else if (property == JSERROR_MESSAGE && text_ != NULL) {
+        v = jsvalue_alloc_string(text_);
+    }
+    else {
+        v.type = JSVALUE_TYPE_NULL;
+        v.value.i64 = 0;
+        v.length = 0;
+    }
+    
+    return v;
+}
+
+void JsErrorInfo::Dispose()
+{
+    exception_.Dispose();
+    if (!message_.IsEmpty())
+        message_.Dispose();
+}
@@ -0,0 +1,154 @@
+// This file is part of the VroomJs library.
+//
+// Author:
+//     Federico Di Gregorio <fog@initd.org>
+//
+// Copyright © 2013 Federico Di Gregorio <fog@initd.org>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "vroomjs.h"
+
+using namespace v8;
+
+extern "C" jsvalue jsvalue_alloc_array(const int32_t length);
+
+JsIterator::JsIterator(Handle<Object> obj) : index_(0)
+{
+    object_ = Persistent<Object>::New(obj);
+    if (obj->IsArray()) {
+        length_ = Handle<Array>::Cast(obj)->Length();
+    }
+    else {
+        keys_ = Persistent<Array>::New(obj->GetOwnPropertyNames());
+        length_ = keys_->Length();
+    }
+}
+
+Local<Value> JsIterator::Next()
+{
+    // The length is taken when the iterator is created: if the array shrinks
+    // in the meantime we just return undefined for the missing elements.
+    if (keys_.IsEmpty())
+        return object_->Get(index_++);
+    else
+        return keys_->Get(index_++);
+}
+
+void JsIterator::Dispose()
+{
+    object_.Dispose();
+    if (!keys_.IsEmpty())
+        keys_.Dispose();
+}
+
+jsvalue JsEngine::IterOpen(Persistent<Object>* obj, const uint16_t* name, JsIterator** iter)
+{
+    jsvalue v;
+    
+    *iter = NULL;
+    
+    CountCall(JSENGINE_CALL_ITER_OPEN);
+    
+    Locker locker(isolate_);
+    Isolate::Scope isolate_scope(isolate_);
+    (*context_)->Enter();
+        
+    HandleScope scope;
+    TryCatch trycatch;
+    
+    Handle<Object> target = obj != NULL ? Handle<Object>(*obj) : Handle<Object>((*context_)->Global());
+    Local<Value> value = target;
+    if (name != NULL)
+        value = target->Get(String::New(name));
+    
+    if (value.IsEmpty()) {
+        v = ErrorFromV8(trycatch);
+    }
+    else {
+        if (value->IsObject()) {
+            *iter = new JsIterator(Handle<Object>::Cast(value));
+            iterators_.insert(*iter);
+        }
+        v = AnyFromV8(Null());
+    }
+    
+    (*context_)->Exit();
+    
+    return v;
+}
+
+jsvalue JsEngine::IterNext(JsIterator* iter, int32_t count)
+{
+    jsvalue v;
+    
+    CountCall(JSENGINE_CALL_ITER_NEXT);
+    
+    Locker locker(isolate_);
+    Isolate::Scope isolate_scope(isolate_);
+    (*context_)->Enter();
+        
+    HandleScope scope;
+    TryCatch trycatch;
+    
+    uint64_t start = jsengine_now_usecs();
+    
+    // We don't know in advance how many elements are left (the length is an
+    // upper bound) so we allocate a full chunk and fix the length at the end;
+    // jsvalue_dispose() only looks at the first "length" elements anyway.
+    
+    v = jsvalue_alloc_array(count);
+    CountAlloc();
+    
+    int32_t n = 0;
+    while (n < count && !iter->IsDone()) {
+        // Each element gets its own scope or we'd keep all the handles of the
+        // chunk alive until the end.
+        HandleScope element_scope;
+        Local<Value> value = iter->Next();
+        if (value.IsEmpty())
+            break;
+        v.value.arr[n++] = AnyFromV8(value);
+    }
+    v.length = n;
+    
+    if (trycatch.HasCaught()) {
+        jsvalue_dispose(v);
+        v = ErrorFromV8(trycatch);
+    }
+    else {
+        RecordLatency(JSENGINE_PHASE_FROM_V8, start);
+    }
+    
+    (*context_)->Exit();
+    
+    return v;
+}
+
+void JsEngine::IterClose(JsIterator* iter)
+{
+    Locker locker(isolate_);
+    Isolate::Scope isolate_scope(isolate_);
+    (*context_)->Enter();
+    
+    iterators_.erase(iter);
+    iter->Dispose();
+    
+    (*context_)->Exit();
+}
@@ -23,6 +23,10 @@
 // OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
 // THE SOFTWARE.
 
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+
 #include "vroomjs.h"
 
 using namespace v8;
@@ -69,10 +73,35 @@ static void managed_destroy(Persistent<Value> object, void* parameter)
     object.Dispose();
 }
 
+// Process-wide V8 settings (flags) can only be changed before the first engine
+// is created: V8 doesn't expect them to change while isolates are running.
+
+static pthread_mutex_t settings_lock = PTHREAD_MUTEX_INITIALIZER;
+static bool engines_created = false;
+
+bool JsEngine::SetProfilerSamplingInterval(int32_t sampling_interval)
+{
+    pthread_mutex_lock(&settings_lock);
+    bool ok = !engines_created;
+    if (ok) {
+        char flags[64];
+        int length = snprintf(flags, sizeof(flags), "--cpu_profiler_sampling_interval=%d", sampling_interval);
+        V8::SetFlagsFromString(flags, length);
+    }
+    pthread_mutex_unlock(&settings_lock);
+    return ok;
+}
+
 JsEngine* JsEngine::New()
 {
+    pthread_mutex_lock(&settings_lock);
+    engines_created = true;
+    pthread_mutex_unlock(&settings_lock);
+    
     JsEngine* engine = new JsEngine();
     if (engine != NULL) {            
+        memset(&engine->metrics_, 0, sizeof(jsengine_metrics));
+        engine->profiling_ = false;
         engine->isolate_ = Isolate::New();
         Locker locker(engine->isolate_);
         Isolate::Scope isolate_scope(engine->isolate_);
@@ -98,6 +127,35 @@ void JsEngine::Dispose()
     {
         Locker locker(isolate_);
         Isolate::Scope isolate_scope(isolate_);
+        if (profiling_) {
+            HandleScope scope;
+            const CpuProfile* profile = CpuProfiler::StopProfiling(String::New(JSENGINE_PROFILE_TITLE));
+            if (profile != NULL)
+                const_cast<CpuProfile*>(profile)->Delete();
+            profiling_ = false;
+        }
+        std::map<std::string, JsModule>::iterator it;
+        for (it = modules_.begin() ; it != modules_.end() ; it++) {
+            it->second.value.Dispose();
+            it->second.file->Release();
+        }
+        modules_.clear();
+        
+        // Live errors keep their message (see JsErrorInfo::Detach()).
+        (*context_)->Enter();
+        std::set<JsErrorInfo*>::iterator err;
+        for (err = errors_.begin() ; err != errors_.end() ; err++)
+            (*err)->Detach();
+        errors_.clear();
+        (*context_)->Exit();
+        
+        // Cursors still open only lose their handles: the memory is freed when
+        // the CLR closes them.
+        std::set<JsIterator*>::iterator iter;
+        for (iter = iterators_.begin() ; iter != iterators_.end() ; iter++)
+            (*iter)->Dispose();
+        iterators_.clear();
+        
         managed_template_->Dispose();
         delete managed_template_;
         context_->Dispose();            
@@ -109,6 +167,8 @@ void JsEngine::Dispose()
 
 void JsEngine::DisposeObject(Persistent<Object>* obj)
 {
+    CountCall(JSENGINE_CALL_DISPOSE_OBJECT);
+    
     Locker locker(isolate_);
     Isolate::Scope isolate_scope(isolate_);
     (*context_)->Enter();
@@ -118,10 +178,111 @@ void JsEngine::DisposeObject(Persistent<Object>* obj)
     (*context_)->Exit();
 }
 
+jsvalue JsEngine::GetErrorProperty(JsErrorInfo* err, int32_t property)
+{
+    jsvalue v;
+    
+    // Line and column are the only values we have already extracted.
+    
+    if (property == JSERROR_LINE || property == JSERROR_COLUMN) {
+        v.type = JSVALUE_TYPE_INTEGER;
+        v.value.i32 = property == JSERROR_LINE ? err->Line() : err->Column();
+        v.length = 0;
+        return v;
+    }
+    
+    Locker locker(isolate_);
+    Isolate::Scope isolate_scope(isolate_);
+    (*context_)->Enter();
+        
+    HandleScope scope;
+    TryCatch trycatch;
+    
+    Handle<Message> message = err->GetMessage();
+    
+    switch (property) {
+    case JSERROR_MESSAGE: {
+        // toString() can throw, and then there is no message at all.
+        Local<String> s = err->GetException()->ToString();
+        v = AnyFromV8(s.IsEmpty() ? Handle<Value>(Null()) : Handle<Value>(s));
+        break;
+    }
+    case JSERROR_SCRIPT_NAME:
+        v = AnyFromV8(message.IsEmpty() ? Handle<Value>(Undefined()) : message->GetScriptResourceName());
+        break;
+    case JSERROR_SOURCE_LINE:
+        v = AnyFromV8(message.IsEmpty() ? Handle<Value>(Undefined()) : Handle<Value>(message->GetSourceLine()));
+        break;
+    case JSERROR_STACK:
+        v = AnyFromV8(err->GetStackText());
+        break;
+    case JSERROR_FRAMES: {
+        Handle<StackTrace> trace;
+        if (!message.IsEmpty())
+            trace = message->GetStackTrace();
+        int count = trace.IsEmpty() ? 0 : trace->GetFrameCount();
+        v = jsvalue_alloc_array(count);
+        CountAlloc();
+        for (int i=0 ; i < count ; i++) {
+            Local<StackFrame> frame = trace->GetFrame(i);
+            jsvalue f = jsvalue_alloc_array(4);
+            CountAlloc();
+            f.value.arr[0] = AnyFromV8(frame->GetFunctionName());
+            f.value.arr[1] = AnyFromV8(frame->GetScriptName());
+            f.value.arr[2].type = JSVALUE_TYPE_INTEGER;
+            f.value.arr[2].value.i32 = frame->GetLineNumber();
+            f.value.arr[3].type = JSVALUE_TYPE_INTEGER;
+            f.value.arr[3].value.i32 = frame->GetColumn();
+            v.value.arr[i] = f;
+        }
+        break;
+    }
+    case JSERROR_EXCEPTION:
+        v = AnyFromV8(err->GetException());
+        break;
+    default:
+        v = AnyFromV8(Null());
+        break;
+    }
+    
+    // Converting can run user code ("stack" getters, toString() on the values
+    // of the frames): if that throws we return nothing instead of a new error.
+    if (trycatch.HasCaught()) {
+        jsvalue_dispose(v);
+        v = AnyFromV8(Null());
+    }
+    
+    (*context_)->Exit();
+    
+    return v;
+}
+
+void JsEngine::DisposeError(JsErrorInfo* err)
+{
+    Locker locker(isolate_);
+    Isolate::Scope isolate_scope(isolate_);
+    (*context_)->Enter();
+    
+    errors_.erase(err);
+    err->Dispose();
+    
+    (*context_)->Exit();
+}
+
+void JsEngine::SetStackCaptureDepth(int32_t depth)
+{
+    Locker locker(isolate_);
+    Isolate::Scope isolate_scope(isolate_);
+    
+    V8::SetCaptureStackTraceForUncaughtExceptions(depth > 0, depth, StackTrace::kDetailed);
+}
+
 jsvalue JsEngine::Execute(const uint16_t* str)
 {
     jsvalue v;
 
+    CountCall(JSENGINE_CALL_EXECUTE);
+    
     Locker locker(isolate_);
     Isolate::Scope isolate_scope(isolate_);
     (*context_)->Enter();
@@ -129,14 +290,23 @@ jsvalue JsEngine::Execute(const uint16_t* str)
     HandleScope scope;
     TryCatch trycatch;
         
+    uint64_t start = jsengine_now_usecs();
     Handle<String> source = String::New(str);    
+    CountBytesToV8(source->Length() * sizeof(uint16_t));
     Handle<Script> script = Script::Compile(source);          
+    RecordLatency(JSENGINE_PHASE_COMPILE, start);
     if (!script.IsEmpty()) {
+        start = jsengine_now_usecs();
         Local<Value> result = script->Run();
-        if (result.IsEmpty())
+        RecordLatency(JSENGINE_PHASE_RUN, start);
+        if (result.IsEmpty()) {
             v = ErrorFromV8(trycatch);
-        else
+        }
+        else {
+            start = jsengine_now_usecs();
             v = AnyFromV8(result);        
+            RecordLatency(JSENGINE_PHASE_FROM_V8, start);
+        }
     }
     else {
         v = ErrorFromV8(trycatch);
@@ -149,13 +319,17 @@ jsvalue JsEngine::Execute(const uint16_t* str)
 
 jsvalue JsEngine::SetVariable(const uint16_t* name, jsvalue value)
 {
+    CountCall(JSENGINE_CALL_SET_VARIABLE);
+    
     Locker locker(isolate_);
     Isolate::Scope isolate_scope(isolate_);
     (*context_)->Enter();
         
     HandleScope scope;
         
+    uint64_t start = jsengine_now_usecs();
     Handle<Value> v = AnyToV8(value);
+    RecordLatency(JSENGINE_PHASE_TO_V8, start);
 
     if ((*context_)->Global()->Set(String::New(name), v) == false) {
         // TODO: Return an error if set failed.
@@ -170,6 +344,8 @@ jsvalue JsEngine::GetVariable(const uint16_t* name)
 {
     jsvalue v;
     
+    CountCall(JSENGINE_CALL_GET_VARIABLE);
+    
     Locker locker(isolate_);
     Isolate::Scope isolate_scope(isolate_);
     (*context_)->Enter();
@@ -179,7 +355,9 @@ jsvalue JsEngine::GetVariable(const uint16_t* name)
                 
     Local<Value> value = (*context_)->Global()->Get(String::New(name));
     if (!value.IsEmpty()) {
+        uint64_t start = jsengine_now_usecs();
         v = AnyFromV8(value);        
+        RecordLatency(JSENGINE_PHASE_FROM_V8, start);
     }
     else {
         v = ErrorFromV8(trycatch);
@@ -194,6 +372,8 @@ jsvalue JsEngine::GetPropertyValue(Persistent<Object>* obj, const uint16_t* name
 {
     jsvalue v;
     
+    CountCall(JSENGINE_CALL_GET_PROPERTY_VALUE);
+    
     Locker locker(isolate_);
     Isolate::Scope isolate_scope(isolate_);
     (*context_)->Enter();
@@ -203,7 +383,9 @@ jsvalue JsEngine::GetPropertyValue(Persistent<Object>* obj, const uint16_t* name
                 
     Local<Value> value = (*obj)->Get(String::New(name));
     if (!value.IsEmpty()) {
+        uint64_t start = jsengine_now_usecs();
         v = AnyFromV8(value);        
+        RecordLatency(JSENGINE_PHASE_FROM_V8, start);
     }
     else {
         v = ErrorFromV8(trycatch);
@@ -216,13 +398,17 @@ jsvalue JsEngine::GetPropertyValue(Persistent<Object>* obj, const uint16_t* name
 
 jsvalue JsEngine::SetPropertyValue(Persistent<Object>* obj, const uint16_t* name, jsvalue value)
 {
+    CountCall(JSENGINE_CALL_SET_PROPERTY_VALUE);
+    
     Locker locker(isolate_);
     Isolate::Scope isolate_scope(isolate_);
     (*context_)->Enter();
         
     HandleScope scope;
         
+    uint64_t start = jsengine_now_usecs();
     Handle<Value> v = AnyToV8(value);
+    RecordLatency(JSENGINE_PHASE_TO_V8, start);
 
     if ((*obj)->Set(String::New(name), v) == false) {
         // TODO: Return an error if set failed.
@@ -237,6 +423,8 @@ jsvalue JsEngine::InvokeProperty(Persistent<Object>* obj, const uint16_t* name,
 {
     jsvalue v;
 
+    CountCall(JSENGINE_CALL_INVOKE_PROPERTY);
+    
     Locker locker(isolate_);
     Isolate::Scope isolate_scope(isolate_);
     (*context_)->Enter();
@@ -250,13 +438,19 @@ jsvalue JsEngine::InvokeProperty(Persistent<Object>* obj, const uint16_t* name,
         v.type = JSVALUE_TYPE_ERROR;   
     }
     else {
+        uint64_t start = jsengine_now_usecs();
         Local<Value> argv[args.length];
         ArrayToV8Args(args, argv);
         // TODO: Check ArrayToV8Args return value (but right now can't fail, right?)                   
+        RecordLatency(JSENGINE_PHASE_TO_V8, start);
         Local<Function> func = Local<Function>::Cast(prop);
+        start = jsengine_now_usecs();
         Local<Value> value = func->Call(*obj, args.length, argv);
+        RecordLatency(JSENGINE_PHASE_RUN, start);
         if (!value.IsEmpty()) {
+            start = jsengine_now_usecs();
             v = AnyFromV8(value);        
+            RecordLatency(JSENGINE_PHASE_FROM_V8, start);
         }
         else {
             v = ErrorFromV8(trycatch);
@@ -282,11 +476,12 @@ jsvalue JsEngine::ErrorFromV8(TryCatch& trycatch)
     
     // If this is a managed exception we need to place its ID inside the jsvalue
     // and set the type JSVALUE_TYPE_MANAGED_ERROR to make sure the CLR side will
-    // throw on it. Else we just wrap and return the exception Object. Note that
-    // this is far from perfect because we ignore both the Message object and the
-    // stack stack trace. If the exception is not an object (but just a string,
-    // for example) we convert it with toString() and return that as an Exception.
-    // TODO: return a composite/special object with stack trace information.
+    // throw on it. Everything else (Error objects, strings, ...) is returned as
+    // a JsErrorInfo together with the Message: no conversion is done here, the
+    // CLR side will ask for message, stack and so on only if it needs them.
+    
+    if (exception.IsEmpty())
+        return v;
     
     if (exception->IsObject()) {
         Local<Object> obj = Local<Object>::Cast(exception);
@@ -294,17 +489,16 @@ jsvalue JsEngine::ErrorFromV8(TryCatch& trycatch)
             ManagedRef* ref = (ManagedRef*)obj->GetPointerFromInternalField(0); 
             v.type = JSVALUE_TYPE_MANAGED_ERROR;
             v.length = ref->Id();
+            return v;
         }
-        else  {
-            v = WrappedFromV8(obj);
-            v.type = JSVALUE_TYPE_WRAPPED_ERROR;        
-        }            
-    }
-    else if (!exception.IsEmpty()) {
-        v = StringFromV8(exception);
-        v.type = JSVALUE_TYPE_ERROR;   
     }
     
+    v.type = JSVALUE_TYPE_ERROR_INFO;
+    JsErrorInfo* err = new JsErrorInfo(exception, trycatch.Message());
+    errors_.insert(err);
+    v.value.ptr = err;
+    CountAlloc();
+    
     return v;
 }
     
@@ -312,12 +506,18 @@ jsvalue JsEngine::StringFromV8(Handle<Value> value)
 {
     jsvalue v;
     
+    // ToString() calls toString() on objects and that can throw: in that case
+    // we return an empty string (the caller knows about the exception).
     Local<String> s = value->ToString();
+    if (s.IsEmpty())
+        s = String::Empty();
     v.length = s->Length();
     v.value.str = new uint16_t[v.length+1];
     if (v.value.str != NULL) {
         s->Write(v.value.str);
         v.type = JSVALUE_TYPE_STRING;
+        CountAlloc();
+        CountBytesFromV8(v.length * sizeof(uint16_t));
     }
 
     return v;
@@ -335,6 +535,7 @@ jsvalue JsEngine::WrappedFromV8(Handle<Object> obj)
     // We should even cast it to void* because C++ doesn't allow to put
     // it in a union: going scary and scarier here.    
     v.value.ptr = new Persistent<Object>(Persistent<Object>::New(obj));
+    CountAlloc();
 
     return v;
 } 
@@ -391,6 +592,7 @@ jsvalue JsEngine::AnyFromV8(Handle<Value> value)
         v.length = object->Length();
         jsvalue* array = new jsvalue[v.length];
         if (array != NULL) {
+            CountAlloc();
             for(int i = 0; i < v.length; i++) {
                 array[i] = AnyFromV8(object->Get(i));
             }
@@ -427,6 +629,7 @@ Handle<Value> JsEngine::AnyToV8(jsvalue v)
         return Number::New(v.value.num);
     }
     if (v.type == JSVALUE_TYPE_STRING) {
+        CountBytesToV8(v.length * sizeof(uint16_t));
         return String::New(v.value.str);
     }
     if (v.type == JSVALUE_TYPE_DATE) {
@@ -442,6 +645,17 @@ Handle<Value> JsEngine::AnyToV8(jsvalue v)
         }
         return a;        
     }
+    
+    // CLR objects projected by value come as "length" key/value pairs stored
+    // one after the other and become plain JS objects, without interceptors.
+    
+    if (v.type == JSVALUE_TYPE_DICT) {
+        Local<Object> o = Object::New();
+        for (int i = 0; i < v.length; i++) {
+            o->Set(AnyToV8(v.value.arr[2*i]), AnyToV8(v.value.arr[2*i+1]));
+        }
+        return o;
+    }
         
     // This is an ID to a managed object that lives inside the JsEngine keep-alive
     // cache. We just wrap it and the pointer to the engine inside an External. A
@@ -471,13 +685,53 @@ int32_t JsEngine::ArrayToV8Args(jsvalue value, Handle<Value> preallocatedArgs[])
     return value.length;
 }
 
+jsvalue JsEngine::ArrayFromArguments(const Arguments& args, jsvalue* slots)
+{
+    jsvalue v;
+    
+    v.type = JSVALUE_TYPE_ARRAY;
+    v.length = args.Length();
+    v.value.arr = slots;
+    
+    for (int i=0 ; i < v.length ; i++) {
+        v.value.arr[i] = AnyFromV8(args[i]);
+    }
+    
+    return v;
+}
+
 jsvalue JsEngine::ArrayFromArguments(const Arguments& args)
 {
     jsvalue v = jsvalue_alloc_array(args.Length());
+    CountAlloc();
     
     for (int i=0 ; i < v.length ; i++) {
         v.value.arr[i] = AnyFromV8(args[i]);
     }
     
     return v;
+}
+
+void JsEngine::RecordLatency(int phase, uint64_t start)
+{
+    uint64_t elapsed = jsengine_now_usecs() - start;
+    
+    int bucket = 0;
+    while (elapsed > 0 && bucket < JSENGINE_LATENCY_BUCKETS-1) {
+        elapsed >>= 1;
+        bucket++;
+    }
+    
+    __sync_fetch_and_add(&metrics_.latency[phase][bucket], 1);
+}
+
+void JsEngine::GetMetrics(jsengine_metrics* metrics)
+{
+    // Adding zero is the cheapest way to get an atomic read of a 64 bit value
+    // using only the builtins, even on 32 bit platforms.
+    
+    int64_t* src = (int64_t*)&metrics_;
+    int64_t* dst = (int64_t*)metrics;
+    for (size_t i=0 ; i < sizeof(jsengine_metrics)/sizeof(int64_t) ; i++)
+        dst[i] = __sync_fetch_and_add(&src[i], 0);
 }
\ No newline at end of file
@@ -68,8 +68,14 @@ Handle<Value> ManagedRef::SetPropertyValue(Local<String> name, Local<Value> valu
 Handle<Value> ManagedRef::Invoke(const Arguments& args)
 {
     Handle<Value> res;
+    
+    // Small calls (the vast majority) use slots on the stack: no allocation at
+    // all unless some of the arguments are strings or arrays.
+    
+    jsvalue slots[JSVALUE_INLINE_ARGS];
+    bool inline_args = args.Length() <= JSVALUE_INLINE_ARGS;
         
-    jsvalue a = engine_->ArrayFromArguments(args);
+    jsvalue a = inline_args ? engine_->ArrayFromArguments(args, slots) : engine_->ArrayFromArguments(args);
     jsvalue r = engine_->CallInvoke(id_, a);
     if (r.type == JSVALUE_TYPE_MANAGED_ERROR)
         res = ThrowException(engine_->AnyToV8(r));
@@ -77,7 +83,13 @@ Handle<Value> ManagedRef::Invoke(const Arguments& args)
         res = engine_->AnyToV8(r);
     
     // We don't need the jsvalue anymore and the CLR side never reuse them.
-    jsvalue_dispose(a);
+    if (inline_args) {
+        for (int i=0 ; i < a.length ; i++)
+            jsvalue_dispose(a.value.arr[i]);
+    }
+    else {
+        jsvalue_dispose(a);
+    }
     jsvalue_dispose(r);
     
     return res;
@@ -0,0 +1,268 @@
+// This file is part of the VroomJs library.
+//
+// Author:
+//     Federico Di Gregorio <fog@initd.org>
+//
+// Copyright © 2013 Federico Di Gregorio <fog@initd.org>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "vroomjs.h"
+
+using namespace v8;
+
+// The process-wide cache of mapped files. It doesn't hold references: entries
+// are removed by Release() when the last user goes away.
+
+static std::map<std::string, MappedFile*> mapped_files;
+static pthread_mutex_t mapped_files_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static char empty_file[] = "";
+
+// Replacing a file by rename changes its inode; the modification time has
+// nanosecond resolution so rewrites within the same second are caught too.
+
+bool MappedFile::Matches(const struct stat& st)
+{
+    return dev_ == st.st_dev && ino_ == st.st_ino && length_ == (size_t)st.st_size
+        && mtime_.tv_sec == st.st_mtim.tv_sec && mtime_.tv_nsec == st.st_mtim.tv_nsec;
+}
+
+MappedFile* MappedFile::Open(const char* path)
+{
+    struct stat st;
+    if (stat(path, &st) != 0 || !S_ISREG(st.st_mode))
+        return NULL;
+    
+    MappedFile* file = NULL;
+    
+    pthread_mutex_lock(&mapped_files_lock);
+    
+    std::map<std::string, MappedFile*>::iterator it = mapped_files.find(path);
+    if (it != mapped_files.end()) {
+        file = it->second;
+        if (file->Matches(st)) {
+            file->AddRef();
+            pthread_mutex_unlock(&mapped_files_lock);
+            return file;
+        }
+        // Stale: drop it from the cache, current users keep the old mapping.
+        mapped_files.erase(it);
+    }
+    
+    file = NULL;
+    int fd = open(path, O_RDONLY);
+    if (fd >= 0 && fstat(fd, &st) == 0) {
+        char* data = empty_file;
+        if (st.st_size > 0) {
+            data = (char*)mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+            if (data == MAP_FAILED)
+                data = NULL;
+        }
+        if (data != NULL) {
+            file = new MappedFile();
+            file->path_ = path;
+            file->data_ = data;
+            file->length_ = st.st_size;
+            file->dev_ = st.st_dev;
+            file->ino_ = st.st_ino;
+            file->mtime_ = st.st_mtim;
+            file->refs_ = 1;
+            file->ascii_ = true;
+            for (size_t i=0 ; i < file->length_ && file->ascii_ ; i++)
+                file->ascii_ = (data[i] & 0x80) == 0;
+            mapped_files[path] = file;
+        }
+    }
+    if (fd >= 0)
+        close(fd);
+    
+    pthread_mutex_unlock(&mapped_files_lock);
+    
+    return file;
+}
+
+// The last reference is released with the cache lock held, so that Open()
+// can't find (and resurrect) a file that is about to be unmapped.
+
+void MappedFile::Release()
+{
+    pthread_mutex_lock(&mapped_files_lock);
+    
+    bool last = __sync_sub_and_fetch(&refs_, 1) == 0;
+    if (last) {
+        std::map<std::string, MappedFile*>::iterator it = mapped_files.find(path_);
+        if (it != mapped_files.end() && it->second == this)
+            mapped_files.erase(it);
+    }
+    
+    pthread_mutex_unlock(&mapped_files_lock);
+    
+    if (last) {
+        if (length_ > 0)
+            munmap(data_, length_);
+        delete this;
+    }
+}
+
+// Backing store for V8 strings built directly on top of a MappedFile. V8 calls
+// Dispose() (that deletes the resource) when the string is collected.
+
+class MappedFileResource : public String::ExternalAsciiStringResource {
+ public:
+    inline explicit MappedFileResource(MappedFile* file) : file_(file) { file_->AddRef(); }
+    ~MappedFileResource() { file_->Release(); }
+    
+    const char* data() const { return file_->Data(); }
+    size_t length() const { return file_->Length(); }
+    
+ private:
+    MappedFile* file_;
+};
+
+Local<Value> JsEngine::RunFile(MappedFile* file, const char* path)
+{
+    uint64_t start = jsengine_now_usecs();
+    
+    // Non-ASCII files are decoded as UTF-8 and that means a copy on the V8 heap.
+    
+    Local<String> source;
+    if (file->IsAscii()) {
+        source = String::NewExternal(new MappedFileResource(file));
+    }
+    else {
+        source = String::New(file->Data(), (int)file->Length());
+        CountBytesToV8(file->Length());
+    }
+    
+    ScriptOrigin origin(String::New(path));
+    Local<Script> script = Script::Compile(source, &origin);
+    RecordLatency(JSENGINE_PHASE_COMPILE, start);
+    if (script.IsEmpty())
+        return Local<Value>();
+    
+    start = jsengine_now_usecs();
+    Local<Value> result = script->Run();
+    RecordLatency(JSENGINE_PHASE_RUN, start);
+    
+    return result;
+}
+
+jsvalue JsEngine::ExecuteFile(const char* path)
+{
+    jsvalue v;
+    
+    CountCall(JSENGINE_CALL_EXECUTE_FILE);
+    
+    MappedFile* file = MappedFile::Open(path);
+    
+    Locker locker(isolate_);
+    Isolate::Scope isolate_scope(isolate_);
+    (*context_)->Enter();
+        
+    HandleScope scope;
+    TryCatch trycatch;
+    
+    if (file == NULL) {
+        v = StringFromV8(String::Concat(String::New("can't read script file: "), String::New(path)));
+        v.type = JSVALUE_TYPE_ERROR;   
+    }
+    else {
+        Local<Value> result = RunFile(file, path);
+        file->Release();
+        if (result.IsEmpty()) {
+            v = ErrorFromV8(trycatch);
+        }
+        else {
+            uint64_t start = jsengine_now_usecs();
+            v = AnyFromV8(result);        
+            RecordLatency(JSENGINE_PHASE_FROM_V8, start);
+        }
+    }
+    
+    (*context_)->Exit();
+    
+    return v;
+}
+
+jsvalue JsEngine::LoadModule(const char* path)
+{
+    jsvalue v;
+    
+    CountCall(JSENGINE_CALL_LOAD_MODULE);
+    
+    MappedFile* file = MappedFile::Open(path);
+    
+    Locker locker(isolate_);
+    Isolate::Scope isolate_scope(isolate_);
+    (*context_)->Enter();
+        
+    HandleScope scope;
+    TryCatch trycatch;
+    
+    if (file == NULL) {
+        v = StringFromV8(String::Concat(String::New("can't read module file: "), String::New(path)));
+        v.type = JSVALUE_TYPE_ERROR;   
+        (*context_)->Exit();
+        return v;
+    }
+    
+    // Same mapping means the file didn't change since we ran it.
+    
+    std::map<std::string, JsModule>::iterator it = modules_.find(path);
+    if (it != modules_.end() && it->second.file == file) {
+        file->Release();
+        v = AnyFromV8(it->second.value);
+        (*context_)->Exit();
+        return v;
+    }
+    
+    Local<Value> result = RunFile(file, path);
+    if (result.IsEmpty()) {
+        file->Release();
+        v = ErrorFromV8(trycatch);
+    }
+    else {
+        if (it != modules_.end()) {
+            it->second.value.Dispose();
+            it->second.file->Release();
+            modules_.erase(it);
+        }
+        
+        // The module keeps the reference we got from Open().
+        JsModule module;
+        module.file = file;
+        module.value = Persistent<Value>::New(result);
+        modules_[path] = module;
+        
+        uint64_t start = jsengine_now_usecs();
+        v = AnyFromV8(result);        
+        RecordLatency(JSENGINE_PHASE_FROM_V8, start);
+    }
+    
+    (*context_)->Exit();
+    
+    return v;
+}
@@ -0,0 +1,295 @@
+// This file is part of the VroomJs library.
+//
+// Author:
+//     Federico Di Gregorio <fog@initd.org>
+//
+// Copyright © 2013 Federico Di Gregorio <fog@initd.org>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include <stdio.h>
+#include <pthread.h>
+
+#include "vroomjs.h"
+
+using namespace v8;
+
+extern "C" jsvalue jsvalue_alloc_array(const int32_t length);
+
+// Builds an error from a C string without touching V8 (workers use it even
+// when the function didn't compile).
+
+static jsvalue error_from_ascii(const char* msg)
+{
+    jsvalue v;
+    
+    int length = 0;
+    while (msg[length] != '\0')
+        length++;
+    
+    v.type = JSVALUE_TYPE_ERROR;
+    v.length = length;
+    v.value.str = new uint16_t[length+1];
+    for (int i=0 ; i <= length ; i++)
+        v.value.str[i] = msg[i];
+    
+    return v;
+}
+
+static jsvalue copy_error(const jsvalue& error)
+{
+    jsvalue v = error;
+    v.value.str = new uint16_t[error.length+1];
+    for (int i=0 ; i <= error.length ; i++)
+        v.value.str[i] = error.value.str[i];
+    return v;
+}
+
+// Errors can't be returned as JsErrorInfo (it belongs to a single engine) so
+// they become strings with the message and the position. Note that toString()
+// can throw: then we only have the position.
+
+static jsvalue error_from_trycatch(JsEngine* engine, TryCatch& trycatch)
+{
+    HandleScope scope;
+    
+    Handle<Message> message = trycatch.Message();
+    Local<Value> exception = trycatch.Exception();
+    
+    Local<String> text;
+    if (!exception.IsEmpty())
+        text = exception->ToString();
+    if (text.IsEmpty())
+        text = String::New("unknown error");
+    
+    if (!message.IsEmpty()) {
+        char position[64];
+        snprintf(position, sizeof(position), " (line %d, column %d)", 
+                 message->GetLineNumber(), message->GetStartColumn() + 1);
+        text = String::Concat(text, String::New(position));
+    }
+    
+    jsvalue v = engine->StringFromV8(text);
+    v.type = JSVALUE_TYPE_ERROR;
+    return v;
+}
+
+// Values crossing engines can't reference anything living inside a single
+// engine: managed objects (keepalive slots are per engine), wrapped objects
+// and errors are all rejected.
+
+static bool is_portable(const jsvalue& v)
+{
+    switch (v.type) {
+    case JSVALUE_TYPE_NULL:
+    case JSVALUE_TYPE_BOOLEAN:
+    case JSVALUE_TYPE_INTEGER:
+    case JSVALUE_TYPE_NUMBER:
+    case JSVALUE_TYPE_STRING:
+    case JSVALUE_TYPE_DATE:
+    case JSVALUE_TYPE_INDEX:
+        return true;
+    case JSVALUE_TYPE_ARRAY:
+        for (int i=0 ; i < v.length ; i++) {
+            if (!is_portable(v.value.arr[i]))
+                return false;
+        }
+        return true;
+    default:
+        return false;
+    }
+}
+
+// Releases a result that can't be returned, including the wrapped objects it
+// may contain; must be called inside the engine that created it.
+
+static void dispose_result(jsvalue v)
+{
+    if (v.type == JSVALUE_TYPE_WRAPPED) {
+        Persistent<Object>* obj = (Persistent<Object>*)v.value.ptr;
+        obj->Dispose();
+        delete obj;
+    }
+    else if (v.type == JSVALUE_TYPE_ARRAY) {
+        for (int i=0 ; i < v.length ; i++) {
+            dispose_result(v.value.arr[i]);
+            v.value.arr[i].type = JSVALUE_TYPE_NULL;
+        }
+        jsvalue_dispose(v);
+    }
+    else {
+        jsvalue_dispose(v);
+    }
+}
+
+void JsEngine::MapChunks(MapJob* job)
+{
+    CountCall(JSENGINE_CALL_PARALLEL_MAP);
+    
+    Locker locker(isolate_);
+    Isolate::Scope isolate_scope(isolate_);
+    (*context_)->Enter();
+        
+    HandleScope scope;
+    TryCatch trycatch;
+    
+    // The function is compiled once per engine, as an expression.
+    
+    uint64_t start = jsengine_now_usecs();
+    Local<String> source = String::Concat(String::New("("), 
+        String::Concat(String::New(job->function), String::New(")")));
+    Local<Script> script = Script::Compile(source);
+    RecordLatency(JSENGINE_PHASE_COMPILE, start);
+    
+    Local<Value> value;
+    if (!script.IsEmpty())
+        value = script->Run();
+    
+    Local<Function> func;
+    jsvalue error;
+    if (value.IsEmpty()) {
+        error = error_from_trycatch(this, trycatch);
+    }
+    else if (!value->IsFunction()) {
+        error = error_from_ascii("parallel_map: the given code doesn't evaluate to a function");
+    }
+    else {
+        func = Local<Function>::Cast(value);
+    }
+    trycatch.Reset();
+    
+    Handle<Object> global = (*context_)->Global();
+    
+    while (true) {
+        int32_t chunk = __sync_fetch_and_add(&job->next_chunk, 1);
+        if (chunk >= job->chunks)
+            break;
+        
+        int64_t end = ((int64_t)chunk + 1) * job->chunk_size;
+        if (end > job->length)
+            end = job->length;
+            
+        for (int32_t i = chunk * job->chunk_size ; i < end ; i++) {
+            if (func.IsEmpty()) {
+                job->output[i] = copy_error(error);
+                continue;
+            }
+            if (!is_portable(job->input[i])) {
+                job->output[i] = error_from_ascii("parallel_map: values must be primitive values or arrays");
+                continue;
+            }
+            
+            HandleScope element_scope;
+            
+            Handle<Value> argv[2];
+            argv[0] = AnyToV8(job->input[i]);
+            argv[1] = Int32::New(i);
+            
+            start = jsengine_now_usecs();
+            Local<Value> result = func->Call(global, 2, argv);
+            RecordLatency(JSENGINE_PHASE_RUN, start);
+            
+            if (result.IsEmpty()) {
+                job->output[i] = error_from_trycatch(this, trycatch);
+                trycatch.Reset();
+                continue;
+            }
+            
+            jsvalue r = AnyFromV8(result);
+            if (!is_portable(r)) {
+                dispose_result(r);
+                r = error_from_ascii("parallel_map: results must be primitive values or arrays");
+            }
+            job->output[i] = r;
+        }
+    }
+    
+    if (func.IsEmpty())
+        jsvalue_dispose(error);
+    
+    (*context_)->Exit();
+}
+
+struct ParallelMapWorker {
+    JsEngine* engine;
+    MapJob* job;
+    pthread_t thread;
+};
+
+static void* parallel_map_worker(void* arg)
+{
+    ParallelMapWorker* worker = (ParallelMapWorker*)arg;
+    worker->engine->MapChunks(worker->job);
+    return NULL;
+}
+
+jsvalue JsEngine::ParallelMap(JsEngine** engines, int32_t count, const uint16_t* function, 
+                              jsvalue input, int32_t chunk_size)
+{
+    if (count <= 0 || chunk_size <= 0)
+        return error_from_ascii("parallel_map: need at least one engine and a positive chunk size");
+    if (input.type != JSVALUE_TYPE_ARRAY)
+        return error_from_ascii("parallel_map: input must be an array");
+    
+    // Chunks are never bigger than the input, so that the chunk arithmetic
+    // below can't overflow.
+    if (chunk_size > input.length && input.length > 0)
+        chunk_size = input.length;
+    
+    // Start from a valid array: a slot no worker gets to is still a value that
+    // can be converted and disposed.
+    jsvalue output = jsvalue_alloc_array(input.length);
+    for (int32_t i=0 ; i < input.length ; i++) {
+        output.value.arr[i].type = JSVALUE_TYPE_NULL;
+        output.value.arr[i].value.i64 = 0;
+        output.value.arr[i].length = 0;
+    }
+    
+    MapJob job;
+    job.function = function;
+    job.input = input.value.arr;
+    job.output = output.value.arr;
+    job.length = input.length;
+    job.chunk_size = chunk_size;
+    job.chunks = (int32_t)(((int64_t)input.length + chunk_size - 1) / chunk_size);
+    job.next_chunk = 0;
+    
+    // The calling thread works too, on the first engine. If a thread can't be
+    // started it doesn't matter: the other workers will take its chunks.
+    
+    ParallelMapWorker* workers = new ParallelMapWorker[count];
+    bool* started = new bool[count];
+    for (int32_t i=1 ; i < count ; i++) {
+        workers[i].engine = engines[i];
+        workers[i].job = &job;
+        started[i] = pthread_create(&workers[i].thread, NULL, parallel_map_worker, &workers[i]) == 0;
+    }
+    
+    engines[0]->MapChunks(&job);
+    
+    for (int32_t i=1 ; i < count ; i++) {
+        if (started[i])
+            pthread_join(workers[i].thread, NULL);
+    }
+    
+    delete[] started;
+    delete[] workers;
+    
+    return output;
+}
@@ -0,0 +1,125 @@
+// This file is part of the VroomJs library.
+//
+// Author:
+//     Federico Di Gregorio <fog@initd.org>
+//
+// Copyright © 2013 Federico Di Gregorio <fog@initd.org>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "vroomjs.h"
+
+using namespace v8;
+
+extern "C" jsvalue jsvalue_alloc_array(const int32_t length);
+
+static int32_t count_profile_nodes(const CpuProfileNode* node)
+{
+    int32_t count = 1;
+    for (int i=0 ; i < node->GetChildrenCount() ; i++)
+        count += count_profile_nodes(node->GetChild(i));
+    return count;
+}
+
+jsvalue JsEngine::StartProfiling()
+{
+    jsvalue v;
+    
+    Locker locker(isolate_);
+    Isolate::Scope isolate_scope(isolate_);
+    (*context_)->Enter();
+        
+    HandleScope scope;
+    
+    if (profiling_) {
+        v = StringFromV8(String::New("profiling already started on this engine"));
+        v.type = JSVALUE_TYPE_ERROR;   
+    }
+    else {
+        // CpuProfiler works on the current isolate so other engines (each one
+        // with its own isolate) are not affected.
+        CpuProfiler::StartProfiling(String::New(JSENGINE_PROFILE_TITLE));
+        profiling_ = true;
+        v = AnyFromV8(Null());
+    }
+    
+    (*context_)->Exit();
+    
+    return v;
+}
+
+jsvalue JsEngine::StopProfiling()
+{
+    jsvalue v;
+    
+    Locker locker(isolate_);
+    Isolate::Scope isolate_scope(isolate_);
+    (*context_)->Enter();
+        
+    HandleScope scope;
+    
+    const CpuProfile* profile = NULL;
+    if (profiling_) {
+        profile = CpuProfiler::StopProfiling(String::New(JSENGINE_PROFILE_TITLE));
+        profiling_ = false;
+    }
+    
+    if (profile == NULL) {
+        v = StringFromV8(String::New("profiling not started on this engine"));
+        v.type = JSVALUE_TYPE_ERROR;   
+    }
+    else {
+        const CpuProfileNode* root = profile->GetTopDownRoot();
+        v = jsvalue_alloc_array(count_profile_nodes(root));
+        CountAlloc();
+        ProfileNodesFromV8(root, -1, v.value.arr, 0);
+        
+        // We copied everything we need, so there is no reason to keep the
+        // profile around in the isolate.
+        const_cast<CpuProfile*>(profile)->Delete();
+    }
+    
+    (*context_)->Exit();
+    
+    return v;
+}
+
+int32_t JsEngine::ProfileNodesFromV8(const CpuProfileNode* node, int32_t parent, jsvalue* nodes, int32_t index)
+{
+    jsvalue n = jsvalue_alloc_array(JSENGINE_PROFILE_NODE_FIELDS);
+    CountAlloc();
+    
+    n.value.arr[0] = StringFromV8(node->GetFunctionName());
+    n.value.arr[1] = StringFromV8(node->GetScriptResourceName());
+    n.value.arr[2].type = JSVALUE_TYPE_INTEGER;
+    n.value.arr[2].value.i32 = node->GetLineNumber();
+    n.value.arr[3].type = JSVALUE_TYPE_INTEGER;
+    n.value.arr[3].value.i32 = (int32_t)node->GetSelfSamplesCount();
+    n.value.arr[4].type = JSVALUE_TYPE_INTEGER;
+    n.value.arr[4].value.i32 = (int32_t)node->GetTotalSamplesCount();
+    n.value.arr[5].type = JSVALUE_TYPE_INTEGER;
+    n.value.arr[5].value.i32 = parent;
+    
+    int32_t self = index;
+    nodes[index++] = n;
+    for (int i=0 ; i < node->GetChildrenCount() ; i++)
+        index = ProfileNodesFromV8(node->GetChild(i), self, nodes, index);
+    
+    return index;
+}
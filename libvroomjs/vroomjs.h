@@ -27,8 +27,14 @@
 #define LIBVROOMJS_H 1
 
 #include <v8.h>
+#include <v8-profiler.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <time.h>
+#include <sys/types.h>
+#include <map>
+#include <set>
+#include <string>
 
 using namespace v8;
 
@@ -49,6 +55,8 @@ using namespace v8;
 #define JSVALUE_TYPE_MANAGED_ERROR  13
 #define JSVALUE_TYPE_WRAPPED        14
 #define JSVALUE_TYPE_WRAPPED_ERROR  15
+#define JSVALUE_TYPE_ERROR_INFO     16
+#define JSVALUE_TYPE_DICT           17
 
 extern "C" 
 {
@@ -75,6 +83,13 @@ extern "C"
     void jsvalue_dispose(jsvalue value);
 }
 
+// Calls with up to JSVALUE_INLINE_ARGS arguments pass them in a fixed array of
+// jsvalue slots allocated on the caller stack instead of in a heap array from
+// jsvalue_alloc_array(): the callee only reads the slots and must never free
+// the array itself (but still owns strings and arrays stored in the slots).
+
+#define JSVALUE_INLINE_ARGS 4
+
 // The only way for the C++/V8 side to call into the CLR is to use the function
 // pointers (CLR, delegates) defined below.
 
@@ -89,6 +104,140 @@ extern "C"
     typedef jsvalue (*keepalive_invoke_f) (int id, jsvalue args);
 }
 
+// Per-engine instrumentation. Counters are plain int64_t updated with the GCC
+// atomic builtins so that they can be read at any time (even from a thread not
+// holding the isolate lock) by jsengine_get_metrics. The struct is blitted as
+// is to the CLR side (JsEngineMetrics) so keep both layouts in sync.
+
+#define JSENGINE_CALL_EXECUTE              0
+#define JSENGINE_CALL_GET_VARIABLE         1
+#define JSENGINE_CALL_SET_VARIABLE         2
+#define JSENGINE_CALL_GET_PROPERTY_VALUE   3
+#define JSENGINE_CALL_SET_PROPERTY_VALUE   4
+#define JSENGINE_CALL_INVOKE_PROPERTY      5
+#define JSENGINE_CALL_DISPOSE_OBJECT       6
+#define JSENGINE_CALL_EXECUTE_FILE         7
+#define JSENGINE_CALL_LOAD_MODULE          8
+#define JSENGINE_CALL_ITER_OPEN            9
+#define JSENGINE_CALL_ITER_NEXT           10
+#define JSENGINE_CALL_PARALLEL_MAP        11
+#define JSENGINE_CALL_MAX                 16
+
+#define JSENGINE_REVERSE_REMOVE            0
+#define JSENGINE_REVERSE_GET_PROPERTY      1
+#define JSENGINE_REVERSE_SET_PROPERTY      2
+#define JSENGINE_REVERSE_INVOKE            3
+#define JSENGINE_REVERSE_MAX               4
+
+#define JSENGINE_PHASE_COMPILE             0
+#define JSENGINE_PHASE_RUN                 1
+#define JSENGINE_PHASE_TO_V8               2
+#define JSENGINE_PHASE_FROM_V8             3
+#define JSENGINE_PHASE_MAX                 4
+
+// Latencies are kept as log2 histograms of microseconds: bucket 0 counts
+// operations faster than 1us, bucket i (i > 0) operations in [2^(i-1), 2^i)
+// and the last bucket everything else (about 4s and up).
+
+#define JSENGINE_LATENCY_BUCKETS          24
+
+extern "C" 
+{
+    struct jsengine_metrics
+    {
+        int64_t calls[JSENGINE_CALL_MAX];
+        int64_t reverse_calls[JSENGINE_REVERSE_MAX];
+        int64_t bytes_to_v8;
+        int64_t bytes_from_v8;
+        int64_t jsvalue_allocs;
+        int64_t latency[JSENGINE_PHASE_MAX][JSENGINE_LATENCY_BUCKETS];
+    };
+}
+
+// Monotonic clock used to time phases; on Linux clock_gettime() is served by
+// the vDSO and costs a few tens of nanoseconds.
+
+static inline uint64_t jsengine_now_usecs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+// Profiles are exported as an array of nodes in depth-first order, each node
+// being itself an array: [function, script, line, self samples, total samples,
+// index of the parent node (-1 for the root)]. That's enough to rebuild the
+// call tree (and any flame graph) offline.
+
+#define JSENGINE_PROFILE_TITLE            "vroomjs"
+#define JSENGINE_PROFILE_NODE_FIELDS       6
+
+// Properties of a JsErrorInfo that can be retrieved by jsengine_error_get. Only
+// line and column are extracted when the error is created; everything else is
+// converted when (and if) the CLR side asks for it.
+
+#define JSERROR_MESSAGE                    0
+#define JSERROR_LINE                       1
+#define JSERROR_COLUMN                     2
+#define JSERROR_SCRIPT_NAME                3
+#define JSERROR_SOURCE_LINE                4
+#define JSERROR_STACK                      5
+#define JSERROR_FRAMES                     6
+#define JSERROR_EXCEPTION                  7
+
+class JsErrorInfo;
+class JsIterator;
+struct MapJob;
+
+// MappedFile is a read-only memory mapping of a script file. Mappings are
+// shared by all the engines in the process: they are cached by path and
+// reused as long as the file (device and inode), its modification time and its
+// size don't change. Each user (V8 external strings, engine modules) holds a
+// reference and the file is unmapped, and dropped from the cache, when the
+// last one is released. Note that V8 expects external strings to never change:
+// deploy new versions of a script by replacing the file (rename) and not by
+// rewriting it in place.
+
+class MappedFile {
+ public:
+    // Returns a mapping with a reference already added for the caller or NULL
+    // if the file can't be read.
+    static MappedFile* Open(const char* path);
+    
+    inline const char* Data() { return data_; }
+    inline size_t Length() { return length_; }
+    
+    // True if the file is plain 7-bit ASCII and can be used directly as the
+    // backing store of a V8 external string, without any copy.
+    inline bool IsAscii() { return ascii_; }
+    
+    inline void AddRef() { __sync_fetch_and_add(&refs_, 1); }
+    void Release();
+    
+ private:
+    inline MappedFile() {}
+    
+    // True if st describes the same version of the file we mapped.
+    bool Matches(const struct stat& st);
+    
+    std::string path_;
+    char* data_;
+    size_t length_;
+    dev_t dev_;
+    ino_t ino_;
+    struct timespec mtime_;
+    bool ascii_;
+    int32_t refs_;
+};
+
+// A module loaded by jsengine_load_module: its value is the completion value
+// of the script and is reused until the file (i.e., the MappedFile) changes.
+
+struct JsModule {
+    MappedFile* file;
+    Persistent<Value> value;
+};
+
 // JsEngine is a single isolated v8 interpreter and is the referenced as an IntPtr
 // by the JsEngine on the CLR side.
 
@@ -102,13 +251,36 @@ class JsEngine {
     inline void SetInvokeDelegate(keepalive_invoke_f delegate) { keepalive_invoke_ = delegate; }
     
     // Call delegates into managed code.
-    inline void CallRemove(int id) { keepalive_remove_(id); }
-    inline jsvalue CallGetPropertyValue(int32_t id, uint16_t* name) { return keepalive_get_property_value_(id, name); }
-    inline jsvalue CallSetPropertyValue(int32_t id, uint16_t* name, jsvalue value) { return keepalive_set_property_value_(id, name, value); }
-    inline jsvalue CallInvoke(int32_t id, jsvalue args) { return keepalive_invoke_(id, args); }
+    inline void CallRemove(int id) { 
+        CountReverseCall(JSENGINE_REVERSE_REMOVE);
+        keepalive_remove_(id); 
+    }
+    inline jsvalue CallGetPropertyValue(int32_t id, uint16_t* name) { 
+        CountReverseCall(JSENGINE_REVERSE_GET_PROPERTY);
+        return keepalive_get_property_value_(id, name); 
+    }
+    inline jsvalue CallSetPropertyValue(int32_t id, uint16_t* name, jsvalue value) { 
+        CountReverseCall(JSENGINE_REVERSE_SET_PROPERTY);
+        return keepalive_set_property_value_(id, name, value); 
+    }
+    inline jsvalue CallInvoke(int32_t id, jsvalue args) { 
+        CountReverseCall(JSENGINE_REVERSE_INVOKE);
+        return keepalive_invoke_(id, args); 
+    }
+    
+    // Instrumentation; see jsengine_metrics above.
+    inline void CountCall(int entry) { __sync_fetch_and_add(&metrics_.calls[entry], 1); }
+    inline void CountReverseCall(int entry) { __sync_fetch_and_add(&metrics_.reverse_calls[entry], 1); }
+    inline void CountBytesToV8(int64_t n) { __sync_fetch_and_add(&metrics_.bytes_to_v8, n); }
+    inline void CountBytesFromV8(int64_t n) { __sync_fetch_and_add(&metrics_.bytes_from_v8, n); }
+    inline void CountAlloc() { __sync_fetch_and_add(&metrics_.jsvalue_allocs, 1); }
+    void RecordLatency(int phase, uint64_t start);
+    void GetMetrics(jsengine_metrics* metrics);
     
     // Called by bridge to execute JS from managed code.
     jsvalue Execute(const uint16_t* str);    
+    jsvalue ExecuteFile(const char* path);
+    jsvalue LoadModule(const char* path);
     jsvalue GetVariable(const uint16_t* name);
     jsvalue SetVariable(const uint16_t* name, jsvalue value);
     jsvalue GetPropertyValue(Persistent<Object>* obj, const uint16_t* name);
@@ -128,11 +300,49 @@ class JsEngine {
     int32_t ArrayToV8Args(jsvalue value, Handle<Value> preallocatedArgs[]);     
     
     // Converts JS function Arguments to an array of jsvalue to call managed code.
+    // The second version uses the given slots (see JSVALUE_INLINE_ARGS).
     jsvalue ArrayFromArguments(const Arguments& args);
+    jsvalue ArrayFromArguments(const Arguments& args, jsvalue* slots);
     
     // Dispose a Persistent<Object> that was pinned on the CLR side by JsObject.
     void DisposeObject(Persistent<Object>* obj);
     
+    // Cursors over big arrays and objects (see JsIterator). If obj is NULL the
+    // global object is used; if name is not NULL the cursor walks that property
+    // of obj instead of obj itself. Open stores the cursor in *iter (NULL if
+    // there is no object) and returns null or the error thrown reading name.
+    jsvalue IterOpen(Persistent<Object>* obj, const uint16_t* name, JsIterator** iter);
+    jsvalue IterNext(JsIterator* iter, int32_t count);
+    void IterClose(JsIterator* iter);
+    
+    // Maps a function over an array of values using all the given engines, one
+    // thread per engine. Values and results can only be primitive values or
+    // arrays (nothing bound to a single engine) and errors are returned in the
+    // result array in place of the failed values.
+    static jsvalue ParallelMap(JsEngine** engines, int32_t count, const uint16_t* function, 
+                               jsvalue input, int32_t chunk_size);
+    
+    // Runs on a worker thread: compiles the function and processes chunks until
+    // there are none left.
+    void MapChunks(MapJob* job);
+    
+    // Lazy access to errors thrown by Javascript code (see JsErrorInfo).
+    jsvalue GetErrorProperty(JsErrorInfo* err, int32_t property);
+    void DisposeError(JsErrorInfo* err);
+    
+    // Number of stack frames captured when an exception is thrown; 0 (the
+    // default) disables the capture altogether.
+    void SetStackCaptureDepth(int32_t depth);
+    
+    // CPU profiling of the scripts running inside this engine (only one profile
+    // at a time). The profile is returned as a flat array of nodes, see below.
+    // The sampling interval is a process-wide V8 flag and can only be set
+    // before the first engine is created (returns false otherwise).
+    static bool SetProfilerSamplingInterval(int32_t sampling_interval);
+    jsvalue StartProfiling();
+    jsvalue StopProfiling();
+    int32_t ProfileNodesFromV8(const CpuProfileNode* node, int32_t parent, jsvalue* nodes, int32_t index);
+    
     void Dispose();
                 
  private:             
@@ -145,6 +355,86 @@ class JsEngine {
     keepalive_get_property_value_f keepalive_get_property_value_;
     keepalive_set_property_value_f keepalive_set_property_value_;
     keepalive_invoke_f keepalive_invoke_;
+    jsengine_metrics metrics_;
+    bool profiling_;
+    std::map<std::string, JsModule> modules_;
+    std::set<JsErrorInfo*> errors_;
+    std::set<JsIterator*> iterators_;
+    
+    // Compiles and runs a script file; the result is empty on errors.
+    Local<Value> RunFile(MappedFile* file, const char* path);
+};
+
+// JsErrorInfo wraps an exception thrown by Javascript code together with its
+// Message (script, position and, if enabled, stack trace). It is passed to the
+// CLR as an opaque pointer, exactly like the Persistent<Object> of wrapped
+// objects, and released by jsengine_dispose_error.
+
+class JsErrorInfo {
+ public:
+    JsErrorInfo(Handle<Value> exception, Handle<Message> message);
+    inline ~JsErrorInfo() { delete[] text_; }
+    
+    inline int32_t Line() { return line_; }
+    inline int32_t Column() { return column_; }
+    inline Handle<Value> GetException() { return exception_; }
+    inline Handle<Message> GetMessage() { return message_; }
+    
+    // Returns the "stack" property of Error objects or, for everything else,
+    // a stack built from the captured frames (undefined if there are none).
+    Handle<Value> GetStackText();
+    
+    // Errors can outlive their engine: when the engine is disposed the message
+    // is converted to a string and the V8 handles are released. After that only
+    // the message, line and column are available (from GetDetached()).
+    void Detach();
+    jsvalue GetDetached(int32_t property);
+    
+    void Dispose();
+    
+ private:
+    Persistent<Value> exception_;
+    Persistent<Message> message_;
+    int32_t line_;
+    int32_t column_;
+    uint16_t* text_;
+};
+
+// JsIterator walks the elements of an array or the own property names of any
+// other object, a chunk at a time, so that the CLR side never needs to have the
+// whole converted array in memory. Like JsErrorInfo it is passed to the CLR as
+// an opaque pointer and released by jsengine_iter_close.
+
+class JsIterator {
+ public:
+    explicit JsIterator(Handle<Object> obj);
+    
+    inline bool IsDone() { return index_ >= length_; }
+    
+    // Returns the next element (or key); must not be called when IsDone().
+    Local<Value> Next();
+    
+    void Dispose();
+    
+ private:
+    Persistent<Object> object_;
+    Persistent<Array> keys_;
+    uint32_t index_;
+    uint32_t length_;
+};
+
+// Shared state of a JsEngine::ParallelMap call. Workers claim chunks of the
+// input by atomically incrementing next_chunk, so faster workers (or workers
+// with cheaper chunks) simply end up processing more of them.
+
+struct MapJob {
+    const uint16_t* function;
+    jsvalue* input;
+    jsvalue* output;
+    int32_t length;
+    int32_t chunk_size;
+    int32_t chunks;
+    int32_t next_chunk;
 };
 
 class ManagedRef {